@@ -1,28 +1,139 @@
 #include <algorithm>
+#include <array>
+#include <bitset>
+#include <charconv>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
 #include <queue>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include <mutex>
 #include <thread>
+#include <type_traits>
 #include <condition_variable>
+#include <atomic>
+#include <cctype>
+#include <climits>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <string_view>
+#include <utility>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_NUMA
+#include <numa.h>
+#include <numaif.h>
+#endif
 
+/*
+ * The --profile counters are compiled in only with make PROFILE=1
+ * (-DSTRACE_PROFILE). Otherwise kProfile is false and every
+ * "if constexpr (kProfile)" block is dropped, clock reads included.
+ */
+#ifdef STRACE_PROFILE
+constexpr bool kProfile = true;
+#else
+constexpr bool kProfile = false;
+#endif
+
+/*
+ * QueueReport summarises how a queue behaved over a run: how long the producer
+ * spent blocked on a full queue and how full the queue got. With kProfile it
+ * also adds up the time consumers spent waiting on an empty queue.
+ */
+struct QueueReport {
+    std::chrono::nanoseconds producerBlocked{0};
+    std::size_t highWaterItems = 0;
+    std::size_t highWaterBytes = 0;
+    std::chrono::nanoseconds consumerBlocked{0};
+};
+
+/* What --profile reports besides the per-worker counters in each SyscallStats. */
+struct PipelineProfile {
+    std::uint64_t inputBytes = 0;
+    std::chrono::nanoseconds runTime{0}; // From opening the inputs until every worker is done; merge excluded
+    // The getline reader of the queue modes: bytes read, and time in its loop less time blocked on a full queue
+    std::uint64_t readerBytes = 0;
+    std::chrono::nanoseconds readerTime{0};
+    bool queued = false; // 'queue' was filled in: the run went through a WorkQueue or RingQueue
+    QueueReport queue;
+    std::chrono::nanoseconds mergeTime{0};
+    std::chrono::nanoseconds printTime{0};
+};
+
+PipelineProfile pipelineProfile;
+
+/* note_queue adds one queue's report to the profile; runs that use several queues report their sum. */
+void note_queue(const QueueReport &r) {
+    QueueReport &q = pipelineProfile.queue;
+    pipelineProfile.queued = true;
+    q.producerBlocked += r.producerBlocked;
+    q.consumerBlocked += r.consumerBlocked;
+    q.highWaterItems = std::max(q.highWaterItems, r.highWaterItems);
+    q.highWaterBytes = std::max(q.highWaterBytes, r.highWaterBytes);
+}
+
+/* Approximate heap cost of one queued line: its buffer plus the string itself. */
+inline std::size_t queued_bytes(const std::string &line) {
+    return line.capacity() + sizeof(std::string);
+}
+
+template <typename Item = std::string>
 class WorkQueue {
 public:
 /* ==================Start of My Code(1)=====================*/
 
-    void push(std::string line) {
+    /*
+     * A WorkQueue holds at most maxItems items (lines, by default) and
+     * maxBytes bytes of item storage, as counted by queued_bytes(); push()
+     * blocks while it is full. 0 means no limit. A single item larger than
+     * the byte limit is still accepted into an empty queue.
+     */
+    explicit WorkQueue(std::size_t maxItems = 0, std::size_t maxBytes = 0)
+        : maxItems_(maxItems), maxBytes_(maxBytes) {}
+
+    void push(Item line) {
         std::unique_lock<std::mutex> lock(mutex_);
 
+        wait_for_space(lock, 1, item_bytes(line)); // Backpressure: block while the queue is full
+        bytes_ += item_bytes(line);
         q_.push(std::move(line)); // Add the input to the back of queue
+        note_high_water();
 
         cv_.notify_one(); // Wake up one thread (consumer)
     }
 
-    bool pop(std::string &out) {
+    bool pop(Item &out) {
         std::unique_lock<std::mutex> lock(mutex_);
         
         cv_.wait(lock, [&]{
@@ -35,6 +146,8 @@ public:
 
         out = std::move(q_.front()); // Change pointed value to the pop value
         q_.pop(); // Delete the front element of the queue
+        bytes_ -= item_bytes(out);
+        if (bounded()) notFull_.notify_one(); // Let a blocked producer continue
         return true; // Continue the process
     }
 
@@ -46,143 +159,4859 @@ public:
         cv_.notify_all(); // Wake up all threads so they can exit once the queue is empty and closed
     }
 
+    /*
+     * push_batch moves every line in 'lines' into the queue under a single
+     * lock acquisition and a single notify. 'lines' is left empty.
+     */
+    void push_batch(std::vector<Item> &lines) {
+        if (lines.empty()) return;
+        std::size_t batchBytes = 0;
+        for (const auto &line : lines) {
+            batchBytes += item_bytes(line);
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        wait_for_space(lock, lines.size(), batchBytes);
+        for (auto &line : lines) {
+            q_.push(std::move(line));
+        }
+        bytes_ += batchBytes;
+        note_high_water();
+        lines.clear();
+
+        cv_.notify_one(); // One consumer takes the batch; pop_batch passes the wake-up on if work is left over
+    }
+
+    /*
+     * pop_batch replaces the contents of 'out' with up to maxItems lines.
+     *
+     * Returns false once the queue is closed and drained, like pop().
+     */
+    bool pop_batch(std::vector<Item> &out, std::size_t maxItems) {
+        out.clear();
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        if constexpr (kProfile) {
+            if (q_.empty() && !closed_) {
+                auto start = std::chrono::steady_clock::now();
+                cv_.wait(lock, [&]{ return !q_.empty() || closed_; });
+                report_.consumerBlocked += std::chrono::steady_clock::now() - start;
+            }
+        }
+        cv_.wait(lock, [&]{
+            return !q_.empty() || closed_;
+        });
+
+        if(q_.empty() && closed_){
+            return false;
+        }
+
+        while (!q_.empty() && out.size() < maxItems) {
+            bytes_ -= item_bytes(q_.front());
+            out.push_back(std::move(q_.front()));
+            q_.pop();
+        }
+        if (!q_.empty()) {
+            cv_.notify_one(); // More work is waiting, hand it to another consumer
+        }
+        if (bounded()) notFull_.notify_all();
+        return true;
+    }
+
+    QueueReport report() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return report_;
+    }
+
+    /* Items queued right now, and the producer's total blocked time so far; safe from any thread. */
+    std::size_t depth() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return q_.size();
+    }
+
+    std::chrono::nanoseconds producer_blocked() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return report_.producerBlocked;
+    }
+
 private:
-    std::queue<std::string> q_;
+    static std::size_t item_bytes(const Item &item) {
+        return queued_bytes(item);
+    }
+
+    bool bounded() const { return maxItems_ != 0 || maxBytes_ != 0; }
+
+    bool has_space(std::size_t items, std::size_t bytes) const {
+        if (q_.empty()) return true; // Never block on an empty queue, even for an oversized batch
+        if (maxItems_ != 0 && q_.size() + items > maxItems_) return false;
+        if (maxBytes_ != 0 && bytes_ + bytes > maxBytes_) return false;
+        return true;
+    }
+
+    void wait_for_space(std::unique_lock<std::mutex> &lock, std::size_t items, std::size_t bytes) {
+        if (has_space(items, bytes)) return;
+        auto start = std::chrono::steady_clock::now();
+        notFull_.wait(lock, [&]{ return has_space(items, bytes); });
+        report_.producerBlocked += std::chrono::steady_clock::now() - start;
+    }
+
+    void note_high_water() {
+        report_.highWaterItems = std::max(report_.highWaterItems, q_.size());
+        report_.highWaterBytes = std::max(report_.highWaterBytes, bytes_);
+    }
+
+    std::queue<Item> q_;
     std::mutex mutex_;
     std::condition_variable cv_;
+    std::condition_variable notFull_; // Signalled when consumers make room
     bool closed_ = false;
+    std::size_t maxItems_ = 0;
+    std::size_t maxBytes_ = 0;
+    std::size_t bytes_ = 0; // Bytes currently held, as counted by item_bytes()
+    QueueReport report_;
 
 /*==================================End of my Code(1)==================================*/
 };
 
+/* Size used to keep independently written atomics on separate cache lines. */
+constexpr std::size_t kCacheLine = 64;
+
+/*
+ * futex_wait sleeps while 'word' still holds 'expected'; futex_wake wakes up
+ * to n threads sleeping on 'word'. Used so idle RingQueue users park in the
+ * kernel instead of spinning.
+ */
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+              "futex word must be a plain 32-bit integer");
+
+void futex_wait(std::atomic<std::uint32_t> &word, std::uint32_t expected) {
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word),
+            FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+void futex_wake(std::atomic<std::uint32_t> &word, int n) {
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word),
+            FUTEX_WAKE_PRIVATE, n, nullptr, nullptr, 0);
+}
+
+/*
+ * RingQueue
+ *
+ * A bounded lock-free multi-producer/multi-consumer queue of lines with the
+ * same push/pop/close (and batch) interface as WorkQueue. Each slot carries a
+ * sequence number that tells producers and consumers whose turn it is, so the
+ * fast path is a single CAS on the head or tail index and no allocation.
+ *
+ * When the ring is empty (consumers) or full (producers) the caller parks on
+ * a futex and is woken by the other side, so idle threads do not busy-wait.
+ */
+class RingQueue {
+public:
+    explicit RingQueue(std::size_t capacity = 1 << 14) {
+        std::size_t n = 2;
+        while (n < capacity) n <<= 1; // Round up to a power of two so we can mask
+        mask_ = n - 1;
+        slots_ = std::vector<Slot>(n);
+        for (std::size_t i = 0; i < n; i++) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    void push(std::string line) {
+        while (!try_push(line)) {
+            park_producer();
+        }
+        wake(itemsSignal_, consumersWaiting_, 1);
+    }
+
+    bool pop(std::string &out) {
+        for (;;) {
+            if (try_pop(out)) {
+                wake(spaceSignal_, producersWaiting_, 1);
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                return try_pop(out); // Pick up anything published just before close()
+            }
+            auto start = kProfile ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+            park(itemsSignal_, consumersWaiting_, [&]{ return has_item() || closed_.load(std::memory_order_acquire); });
+            if constexpr (kProfile) {
+                auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+                consumerBlockedNs_.fetch_add(waited.count(), std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void close() {
+        closed_.store(true, std::memory_order_seq_cst);
+        itemsSignal_.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake(itemsSignal_, INT_MAX); // Release every parked consumer
+    }
+
+    void push_batch(std::vector<std::string> &lines) {
+        int pushed = 0;
+        for (auto &line : lines) {
+            while (!try_push(line)) {
+                wake(itemsSignal_, consumersWaiting_, INT_MAX); // Let consumers drain what we have so far
+                park_producer();
+            }
+            pushed++;
+        }
+        lines.clear();
+        if (pushed > 0) wake(itemsSignal_, consumersWaiting_, pushed);
+
+        std::size_t depth = tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_relaxed);
+        report_.highWaterItems = std::max(report_.highWaterItems, std::min(depth, mask_ + 1));
+    }
+
+    bool pop_batch(std::vector<std::string> &out, std::size_t maxItems) {
+        out.clear();
+        std::string line;
+        if (!pop(line)) return false;
+        out.push_back(std::move(line));
+        while (out.size() < maxItems && try_pop(line)) {
+            out.push_back(std::move(line));
+        }
+        wake(spaceSignal_, producersWaiting_, INT_MAX);
+        return true;
+    }
+
+    /* Only meaningful once the producer has finished (it is not synchronised). */
+    QueueReport report() const {
+        QueueReport r = report_;
+        r.consumerBlocked = std::chrono::nanoseconds(consumerBlockedNs_.load(std::memory_order_relaxed));
+        return r;
+    }
+
+    /* Items queued right now, and the producer's total blocked time so far; safe from any thread. */
+    std::size_t depth() const {
+        // head_ first: head_ never passes tail_ and tail_ only grows, so the later tail_ read is not behind it
+        std::size_t head = head_.load(std::memory_order_acquire);
+        std::size_t tail = tail_.load(std::memory_order_acquire);
+        return tail > head ? std::min(tail - head, mask_ + 1) : 0;
+    }
+
+    std::chrono::nanoseconds producer_blocked() const {
+        return std::chrono::nanoseconds(blockedNs_.load(std::memory_order_relaxed));
+    }
+
+private:
+    struct alignas(kCacheLine) Slot {
+        std::atomic<std::size_t> seq{0};
+        std::string value;
+    };
+
+    bool try_push(std::string &line) {
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;) {
+            slot = &slots_[pos & mask_];
+            std::size_t seq = slot->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; // Full: the slot still holds an item from the previous lap
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = std::move(line);
+        slot->seq.store(pos + 1, std::memory_order_release); // Publish to consumers
+        return true;
+    }
+
+    bool try_pop(std::string &out) {
+        std::size_t pos = head_.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;) {
+            slot = &slots_[pos & mask_];
+            std::size_t seq = slot->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; // Empty: nothing has been published in this slot yet
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(slot->value);
+        slot->seq.store(pos + mask_ + 1, std::memory_order_release); // Hand the slot back to producers
+        return true;
+    }
+
+    bool has_item() const {
+        std::size_t pos = head_.load(std::memory_order_acquire);
+        return slots_[pos & mask_].seq.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    bool has_space() const {
+        std::size_t pos = tail_.load(std::memory_order_acquire);
+        return slots_[pos & mask_].seq.load(std::memory_order_acquire) == pos;
+    }
+
+    /*
+     * park sleeps on 'signal' until 'ready' holds. The waiter count is raised
+     * before 'ready' is rechecked, and wake() only skips the futex call when
+     * it sees no waiters, so between the two fences one side always notices
+     * the other and a wake-up cannot be lost.
+     */
+    template <typename Ready>
+    void park(std::atomic<std::uint32_t> &signal, std::atomic<int> &waiters, Ready ready) {
+        for (int spin = 0; spin < 64; spin++) {
+            if (ready()) return;
+        }
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::uint32_t seen = signal.load(std::memory_order_seq_cst);
+        if (!ready()) {
+            futex_wait(signal, seen);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void park_producer() {
+        auto start = std::chrono::steady_clock::now();
+        park(spaceSignal_, producersWaiting_, [&]{ return has_space(); });
+        auto blocked = std::chrono::steady_clock::now() - start;
+        report_.producerBlocked += blocked;
+        blockedNs_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(blocked).count(), std::memory_order_relaxed);
+    }
+
+    void wake(std::atomic<std::uint32_t> &signal, std::atomic<int> &waiters, int n) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0) {
+            signal.fetch_add(1, std::memory_order_seq_cst);
+            futex_wake(signal, n);
+        }
+    }
+
+    std::vector<Slot> slots_;
+    std::size_t mask_ = 0;
+    alignas(kCacheLine) std::atomic<std::size_t> head_{0}; // Next slot to pop
+    alignas(kCacheLine) std::atomic<std::size_t> tail_{0}; // Next slot to push
+    alignas(kCacheLine) std::atomic<std::uint32_t> itemsSignal_{0}; // Bumped when items are published
+    std::atomic<int> consumersWaiting_{0};
+    alignas(kCacheLine) std::atomic<std::uint32_t> spaceSignal_{0}; // Bumped when slots are freed
+    std::atomic<int> producersWaiting_{0};
+    std::atomic<bool> closed_{false};
+    QueueReport report_; // Written by the producer only
+    std::atomic<std::int64_t> blockedNs_{0}; // report_.producerBlocked, readable while the producer runs
+    std::atomic<std::int64_t> consumerBlockedNs_{0}; // kProfile: summed over all consumers
+};
+
+/*
+ * WorkStealer runs tasks on a fixed set of workers, each with its own deque.
+ * A worker takes from the front of its own deque and, once that is empty,
+ * steals from the back of another's, so workers mostly touch their own lock
+ * and their own stretch of the input. A running task may push more work,
+ * e.g. the rest of a chunk it splits off because hungry() says another
+ * worker is idle; run() returns once every deque is empty and no task is
+ * running. Idle workers park on a futex rather than spin.
+ */
+template <typename Task>
+class WorkStealer {
+public:
+    explicit WorkStealer(std::size_t workers) : deques_(std::max<std::size_t>(workers, 1)) {}
+
+    std::size_t workers() const { return deques_.size(); }
+
+    /* push adds a task behind those already queued for 'worker'. */
+    void push(std::size_t worker, Task task) {
+        outstanding_.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(deques_[worker].mutex);
+            deques_[worker].tasks.push_back(std::move(task));
+        }
+        wake(1);
+    }
+
+    /* hungry tells a running task that some worker has run out of work. */
+    bool hungry() const { return idle_.load(std::memory_order_relaxed) != 0; }
+
+    /* has_queued tells whether 'worker' still has tasks waiting in its own deque, which a thief can take. */
+    bool has_queued(std::size_t worker) {
+        std::lock_guard<std::mutex> lock(deques_[worker].mutex);
+        return !deques_[worker].tasks.empty();
+    }
+
+    std::size_t steals() const { return steals_.load(std::memory_order_relaxed); }
+
+    /* run calls fn(worker, task) for every task, on workers() threads including this one. */
+    template <typename Fn>
+    void run(Fn fn) {
+        run(fn, [](std::size_t) {});
+    }
+
+    /* As run(fn), but each worker's thread first calls start(worker), e.g. to pin itself. */
+    template <typename Fn, typename Start>
+    void run(Fn fn, Start start) {
+        auto work = [&](std::size_t w) {
+            start(w);
+            Task task;
+            while (take(w, task)) {
+                fn(w, task);
+                if (outstanding_.fetch_sub(1) == 1) wake(INT_MAX); // Last task done: release the idle workers
+            }
+        };
+        std::vector<std::thread> threads;
+        threads.reserve(workers() - 1);
+        for (std::size_t w = 1; w < workers(); w++) {
+            threads.emplace_back(work, w);
+        }
+        work(0);
+        for (auto &t : threads) {
+            t.join();
+        }
+    }
+
+private:
+    struct alignas(kCacheLine) Deque {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void wake(int n) {
+        signal_.fetch_add(1);
+        if (idle_.load() != 0) futex_wake(signal_, n);
+    }
+
+    bool try_take(std::size_t w, Task &task) {
+        for (std::size_t k = 0; k < deques_.size(); k++) {
+            Deque &d = deques_[(w + k) % deques_.size()];
+            std::lock_guard<std::mutex> lock(d.mutex);
+            if (d.tasks.empty()) continue;
+            if (k == 0) {
+                task = std::move(d.tasks.front());
+                d.tasks.pop_front();
+            } else {
+                task = std::move(d.tasks.back());
+                d.tasks.pop_back();
+                steals_.fetch_add(1, std::memory_order_relaxed);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    /* take waits for a task for worker w; false once all the work is done. */
+    bool take(std::size_t w, Task &task) {
+        for (;;) {
+            if (try_take(w, task)) return true;
+            std::uint32_t seen = signal_.load();
+            idle_.fetch_add(1);
+            bool found = try_take(w, task); // A push after 'seen' changes signal_, so the wait below cannot miss it
+            if (!found && outstanding_.load() != 0) futex_wait(signal_, seen);
+            idle_.fetch_sub(1);
+            if (found) return true;
+            if (outstanding_.load() == 0) return false;
+        }
+    }
+
+    std::vector<Deque> deques_;
+    alignas(kCacheLine) std::atomic<std::size_t> outstanding_{0}; // Tasks queued or running
+    std::atomic<std::uint32_t> signal_{0}; // Bumped on every push and when the work runs out
+    std::atomic<int> idle_{0};
+    std::atomic<std::size_t> steals_{0};
+};
+
 struct Stats {
     std::uint64_t count = 0;
     std::uint64_t fails = 0;
 };
 
 
-using StatsMap = std::unordered_map<std::string, Stats>;
+/*
+ * StringHash lets StatsMap be searched with a std::string_view (heterogeneous
+ * lookup), so a syscall name never has to be copied just to find its entry.
+ */
+struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const {
+        return std::hash<std::string_view>{}(s);
+    }
+};
+
+using StatsMap = std::unordered_map<std::string, Stats, StringHash, std::equal_to<>>;
 
 
-int parse_line(const std::string &line, std::string &syscall, int &result) {
-    std::size_t posOpen = line.find('(');
-    if (posOpen == std::string::npos) return 0;
-    syscall = line.substr(0, posOpen);
+/*
+ * x86-64 system call names in syscall-number order (from asm/unistd_64.h,
+ * up to Linux 6.13). Names strace prints that are not listed here, e.g.
+ * "syscall_0x1c8", are still counted through the overflow StatsMap.
+ */
+constexpr std::string_view kSyscallNames[] = {
+    "read", "write", "open", "close", "stat", "fstat", "lstat", "poll", "lseek",
+    "mmap", "mprotect", "munmap", "brk", "rt_sigaction", "rt_sigprocmask",
+    "rt_sigreturn", "ioctl", "pread64", "pwrite64", "readv", "writev", "access",
+    "pipe", "select", "sched_yield", "mremap", "msync", "mincore", "madvise",
+    "shmget", "shmat", "shmctl", "dup", "dup2", "pause", "nanosleep",
+    "getitimer", "alarm", "setitimer", "getpid", "sendfile", "socket",
+    "connect", "accept", "sendto", "recvfrom", "sendmsg", "recvmsg", "shutdown",
+    "bind", "listen", "getsockname", "getpeername", "socketpair", "setsockopt",
+    "getsockopt", "clone", "fork", "vfork", "execve", "exit", "wait4", "kill",
+    "uname", "semget", "semop", "semctl", "shmdt", "msgget", "msgsnd", "msgrcv",
+    "msgctl", "fcntl", "flock", "fsync", "fdatasync", "truncate", "ftruncate",
+    "getdents", "getcwd", "chdir", "fchdir", "rename", "mkdir", "rmdir",
+    "creat", "link", "unlink", "symlink", "readlink", "chmod", "fchmod",
+    "chown", "fchown", "lchown", "umask", "gettimeofday", "getrlimit",
+    "getrusage", "sysinfo", "times", "ptrace", "getuid", "syslog", "getgid",
+    "setuid", "setgid", "geteuid", "getegid", "setpgid", "getppid", "getpgrp",
+    "setsid", "setreuid", "setregid", "getgroups", "setgroups", "setresuid",
+    "getresuid", "setresgid", "getresgid", "getpgid", "setfsuid", "setfsgid",
+    "getsid", "capget", "capset", "rt_sigpending", "rt_sigtimedwait",
+    "rt_sigqueueinfo", "rt_sigsuspend", "sigaltstack", "utime", "mknod",
+    "uselib", "personality", "ustat", "statfs", "fstatfs", "sysfs",
+    "getpriority", "setpriority", "sched_setparam", "sched_getparam",
+    "sched_setscheduler", "sched_getscheduler", "sched_get_priority_max",
+    "sched_get_priority_min", "sched_rr_get_interval", "mlock", "munlock",
+    "mlockall", "munlockall", "vhangup", "modify_ldt", "pivot_root", "_sysctl",
+    "prctl", "arch_prctl", "adjtimex", "setrlimit", "chroot", "sync", "acct",
+    "settimeofday", "mount", "umount2", "swapon", "swapoff", "reboot",
+    "sethostname", "setdomainname", "iopl", "ioperm", "create_module",
+    "init_module", "delete_module", "get_kernel_syms", "query_module",
+    "quotactl", "nfsservctl", "getpmsg", "putpmsg", "afs_syscall", "tuxcall",
+    "security", "gettid", "readahead", "setxattr", "lsetxattr", "fsetxattr",
+    "getxattr", "lgetxattr", "fgetxattr", "listxattr", "llistxattr",
+    "flistxattr", "removexattr", "lremovexattr", "fremovexattr", "tkill",
+    "time", "futex", "sched_setaffinity", "sched_getaffinity",
+    "set_thread_area", "io_setup", "io_destroy", "io_getevents", "io_submit",
+    "io_cancel", "get_thread_area", "lookup_dcookie", "epoll_create",
+    "epoll_ctl_old", "epoll_wait_old", "remap_file_pages", "getdents64",
+    "set_tid_address", "restart_syscall", "semtimedop", "fadvise64",
+    "timer_create", "timer_settime", "timer_gettime", "timer_getoverrun",
+    "timer_delete", "clock_settime", "clock_gettime", "clock_getres",
+    "clock_nanosleep", "exit_group", "epoll_wait", "epoll_ctl", "tgkill",
+    "utimes", "vserver", "mbind", "set_mempolicy", "get_mempolicy", "mq_open",
+    "mq_unlink", "mq_timedsend", "mq_timedreceive", "mq_notify",
+    "mq_getsetattr", "kexec_load", "waitid", "add_key", "request_key", "keyctl",
+    "ioprio_set", "ioprio_get", "inotify_init", "inotify_add_watch",
+    "inotify_rm_watch", "migrate_pages", "openat", "mkdirat", "mknodat",
+    "fchownat", "futimesat", "newfstatat", "unlinkat", "renameat", "linkat",
+    "symlinkat", "readlinkat", "fchmodat", "faccessat", "pselect6", "ppoll",
+    "unshare", "set_robust_list", "get_robust_list", "splice", "tee",
+    "sync_file_range", "vmsplice", "move_pages", "utimensat", "epoll_pwait",
+    "signalfd", "timerfd_create", "eventfd", "fallocate", "timerfd_settime",
+    "timerfd_gettime", "accept4", "signalfd4", "eventfd2", "epoll_create1",
+    "dup3", "pipe2", "inotify_init1", "preadv", "pwritev", "rt_tgsigqueueinfo",
+    "perf_event_open", "recvmmsg", "fanotify_init", "fanotify_mark",
+    "prlimit64", "name_to_handle_at", "open_by_handle_at", "clock_adjtime",
+    "syncfs", "sendmmsg", "setns", "getcpu", "process_vm_readv",
+    "process_vm_writev", "kcmp", "finit_module", "sched_setattr",
+    "sched_getattr", "renameat2", "seccomp", "getrandom", "memfd_create",
+    "kexec_file_load", "bpf", "execveat", "userfaultfd", "membarrier", "mlock2",
+    "copy_file_range", "preadv2", "pwritev2", "pkey_mprotect", "pkey_alloc",
+    "pkey_free", "statx", "io_pgetevents", "rseq", "pidfd_send_signal",
+    "io_uring_setup", "io_uring_enter", "io_uring_register", "open_tree",
+    "move_mount", "fsopen", "fsconfig", "fsmount", "fspick", "pidfd_open",
+    "clone3", "close_range", "openat2", "pidfd_getfd", "faccessat2",
+    "process_madvise", "epoll_pwait2", "mount_setattr", "quotactl_fd",
+    "landlock_create_ruleset", "landlock_add_rule", "landlock_restrict_self",
+    "memfd_secret", "process_mrelease", "futex_waitv",
+    "set_mempolicy_home_node", "cachestat", "fchmodat2", "map_shadow_stack",
+    "futex_wake", "futex_wait", "futex_requeue", "statmount", "listmount",
+    "lsm_get_self_attr", "lsm_set_self_attr", "lsm_list_modules", "mseal",
+    "setxattrat", "getxattrat", "listxattrat", "removexattrat",
+};
+constexpr std::size_t kSyscallCount = std::size(kSyscallNames);
 
-    std::size_t posEq = line.rfind('=');
-    if (posEq == std::string::npos) return 0;
+/*
+ * kSortedSyscalls is the table sorted by name. A syscall's dense ID is its
+ * position here, so walking Stats arrays in ID order is alphabetical order.
+ */
+constexpr auto kSortedSyscalls = []{
+    std::array<std::string_view, kSyscallCount> names{};
+    std::copy(std::begin(kSyscallNames), std::end(kSyscallNames), names.begin());
+    std::sort(names.begin(), names.end());
+    return names;
+}();
 
-    std::size_t resultStart = line.find_first_not_of(' ', posEq + 1);
-    if (resultStart == std::string::npos) return 0;
+static_assert(std::adjacent_find(kSortedSyscalls.begin(), kSortedSyscalls.end()) == kSortedSyscalls.end(),
+              "duplicate syscall name in kSyscallNames");
 
-    std::string resultStr = line.substr(resultStart);
-    try {
-        result = std::stoi(resultStr);
-    } catch (...) {
-        return 0;  /* failed to parse integer */
+/* FNV-1a, cheap for the short names we hash. */
+constexpr std::uint32_t syscall_hash(std::string_view name) {
+    std::uint32_t h = 2166136261u;
+    for (char c : name) {
+        h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
     }
-    return 1;
+    return h;
 }
 
+/*
+ * kSyscallSlots is an open-addressing (linear probing) index from name hash
+ * to dense ID + 1, built entirely at compile time. It is sparse enough that
+ * a lookup almost always resolves on the first slot.
+ */
+constexpr std::size_t kSyscallSlotCount = 2048;
+constexpr auto kSyscallSlots = []{
+    std::array<std::uint16_t, kSyscallSlotCount> slots{};
+    for (std::size_t id = 0; id < kSyscallCount; id++) {
+        std::size_t h = syscall_hash(kSortedSyscalls[id]) & (kSyscallSlotCount - 1);
+        while (slots[h] != 0) h = (h + 1) & (kSyscallSlotCount - 1);
+        slots[h] = static_cast<std::uint16_t>(id + 1);
+    }
+    return slots;
+}();
 
-void update_stats(StatsMap &stats, const std::string &syscall, int result) {
-    Stats &s = stats[syscall];
-    s.count++;
-    if (result < 0) {
-        s.fails++;
+constexpr int kUnknownSyscall = -1;
+
+/* syscall_id maps a name to its dense ID, or kUnknownSyscall. */
+constexpr int syscall_id(std::string_view name) {
+    std::size_t h = syscall_hash(name) & (kSyscallSlotCount - 1);
+    while (kSyscallSlots[h] != 0) {
+        int id = kSyscallSlots[h] - 1;
+        if (kSortedSyscalls[id] == name) return id;
+        h = (h + 1) & (kSyscallSlotCount - 1);
     }
+    return kUnknownSyscall;
 }
 
+static_assert(syscall_id("openat") >= 0 && kSortedSyscalls[syscall_id("openat")] == "openat");
+static_assert(syscall_id("not_a_syscall") == kUnknownSyscall);
 
-void print_stats(const StatsMap &stats) {
-    std::vector<std::string> names;
-    names.reserve(stats.size());
+/*
+ * Linux errno names in errno-number order (asm-generic/errno*.h, without the
+ * aliases EWOULDBLOCK and EDEADLOCK). An errno's ID is its position here;
+ * names strace prints that are not listed, such as the kernel-internal
+ * ERESTARTSYS, are counted as kOtherErrno.
+ */
+constexpr std::string_view kErrnoNames[] = {
+    "EPERM", "ENOENT", "ESRCH", "EINTR", "EIO", "ENXIO", "E2BIG", "ENOEXEC",
+    "EBADF", "ECHILD", "EAGAIN", "ENOMEM", "EACCES", "EFAULT", "ENOTBLK",
+    "EBUSY", "EEXIST", "EXDEV", "ENODEV", "ENOTDIR", "EISDIR", "EINVAL",
+    "ENFILE", "EMFILE", "ENOTTY", "ETXTBSY", "EFBIG", "ENOSPC", "ESPIPE",
+    "EROFS", "EMLINK", "EPIPE", "EDOM", "ERANGE", "EDEADLK", "ENAMETOOLONG",
+    "ENOLCK", "ENOSYS", "ENOTEMPTY", "ELOOP", "ENOMSG", "EIDRM", "ECHRNG",
+    "EL2NSYNC", "EL3HLT", "EL3RST", "ELNRNG", "EUNATCH", "ENOCSI", "EL2HLT",
+    "EBADE", "EBADR", "EXFULL", "ENOANO", "EBADRQC", "EBADSLT", "EBFONT",
+    "ENOSTR", "ENODATA", "ETIME", "ENOSR", "ENONET", "ENOPKG", "EREMOTE",
+    "ENOLINK", "EADV", "ESRMNT", "ECOMM", "EPROTO", "EMULTIHOP", "EDOTDOT",
+    "EBADMSG", "EOVERFLOW", "ENOTUNIQ", "EBADFD", "EREMCHG", "ELIBACC",
+    "ELIBBAD", "ELIBSCN", "ELIBMAX", "ELIBEXEC", "EILSEQ", "ERESTART",
+    "ESTRPIPE", "EUSERS", "ENOTSOCK", "EDESTADDRREQ", "EMSGSIZE", "EPROTOTYPE",
+    "ENOPROTOOPT", "EPROTONOSUPPORT", "ESOCKTNOSUPPORT", "EOPNOTSUPP",
+    "EPFNOSUPPORT", "EAFNOSUPPORT", "EADDRINUSE", "EADDRNOTAVAIL", "ENETDOWN",
+    "ENETUNREACH", "ENETRESET", "ECONNABORTED", "ECONNRESET", "ENOBUFS",
+    "EISCONN", "ENOTCONN", "ESHUTDOWN", "ETOOMANYREFS", "ETIMEDOUT",
+    "ECONNREFUSED", "EHOSTDOWN", "EHOSTUNREACH", "EALREADY", "EINPROGRESS",
+    "ESTALE", "EUCLEAN", "ENOTNAM", "ENAVAIL", "EISNAM", "EREMOTEIO", "EDQUOT",
+    "ENOMEDIUM", "EMEDIUMTYPE", "ECANCELED", "ENOKEY", "EKEYEXPIRED",
+    "EKEYREVOKED", "EKEYREJECTED", "EOWNERDEAD", "ENOTRECOVERABLE", "ERFKILL",
+    "EHWPOISON",
+};
+constexpr std::size_t kErrnoCount = std::size(kErrnoNames);
+constexpr std::size_t kOtherErrno = kErrnoCount;
 
-    for (const auto &pair : stats) {
-        names.push_back(pair.first);
+/* (name, ID) pairs sorted by name, for a binary search in errno_id. */
+constexpr auto kSortedErrnos = []{
+    std::array<std::pair<std::string_view, std::uint8_t>, kErrnoCount> sorted{};
+    for (std::size_t id = 0; id < kErrnoCount; id++) {
+        sorted[id] = {kErrnoNames[id], static_cast<std::uint8_t>(id)};
     }
-    std::sort(names.begin(), names.end());
+    std::sort(sorted.begin(), sorted.end());
+    return sorted;
+}();
 
-    for (const auto &name : names) {
-        const Stats &s = stats.at(name);
-        std::cout << name << ": count=" << s.count
-                  << ", fails=" << s.fails << "\n";
-    }
+/* errno_id maps a name such as "ENOENT" to its ID, or kOtherErrno. */
+constexpr std::size_t errno_id(std::string_view name) {
+    auto it = std::lower_bound(kSortedErrnos.begin(), kSortedErrnos.end(), name,
+                               [](const auto &entry, std::string_view n) { return entry.first < n; });
+    return (it != kSortedErrnos.end() && it->first == name) ? it->second : kOtherErrno;
 }
 
+static_assert(kErrnoNames[errno_id("ENOENT")] == "ENOENT");
+static_assert(errno_id("ERESTARTSYS") == kOtherErrno);
 
-int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0]
-                  << " <trace_file> [num_threads]\n";
-        return 1;
+/* Failures of one syscall by errno ID; the last slot is kOtherErrno. */
+using ErrnoCounts = std::array<std::uint64_t, kErrnoCount + 1>;
+
+/*
+ * PidStats counts calls per (pid, syscall) for --per-pid. Entries are keyed by
+ * pid_key() and spread over kPidShards maps by pid, so that shard s of every
+ * worker can be merged by one merge thread without locks (merge_all).
+ * Syscalls outside the known table share the "other" slot, kSyscallCount.
+ */
+constexpr std::size_t kPidShards = 64;
+
+struct PidStats {
+    std::array<std::unordered_map<std::uint64_t, Stats>, kPidShards> shards;
+};
+
+constexpr std::uint64_t pid_key(std::uint32_t pid, std::size_t id) {
+    return (std::uint64_t(pid) << 16) | id;
+}
+
+constexpr std::size_t pid_shard(std::uint32_t pid) {
+    return (pid * 0x9e3779b1u >> 16) % kPidShards; // Consecutive pids land in different shards
+}
+
+/* Set from --per-pid; when false PidStats stay empty and cost nothing. */
+bool trackPids = false;
+
+/*
+ * LatencyHistogram records syscall durations (from strace -T) in nanoseconds
+ * in a fixed set of log-linear buckets, HDR-histogram style: values below 32
+ * get a bucket each, and every power of two above that is cut into 16 equal
+ * sub-buckets, so any value is known to within 1/16 (6.25%). Recording is an
+ * index computation and an increment, and merging is an element-wise add.
+ * The last bucket is open-ended: every duration from 31 * 2^40 ns (about
+ * 9.47 hours) up is counted in it.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 4;
+    static constexpr std::uint64_t kSubBuckets = 1 << kSubBits;
+    static constexpr int kMaxExponent = 45; // Buckets cover [0, 2^45) ns; the last one also takes the rest
+    static constexpr std::size_t kBuckets = (kMaxExponent - kSubBits + 1) * kSubBuckets;
+
+    void record(std::uint64_t ns) {
+        counts_[bucket_of(ns)]++;
+        count_++;
+        totalNs_ += ns;
+        maxNs_ = std::max(maxNs_, ns);
+    }
+
+    void merge(const LatencyHistogram &other) {
+        for (std::size_t i = 0; i < kBuckets; i++) {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        totalNs_ += other.totalNs_;
+        maxNs_ = std::max(maxNs_, other.maxNs_);
+    }
+
+    /* Smallest recorded value v such that perMille/1000 of the samples are <= v (to bucket precision). */
+    std::uint64_t quantile(std::uint64_t perMille) const {
+        if (count_ == 0) return 0;
+        // ceil(count_ * perMille / 1000), split so the product cannot overflow
+        std::uint64_t rank = count_ / 1000 * perMille + (count_ % 1000 * perMille + 999) / 1000;
+        rank = std::clamp<std::uint64_t>(rank, 1, count_);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; i++) {
+            seen += counts_[i];
+            if (seen >= rank) return std::min(bucket_upper(i), maxNs_);
+        }
+        return maxNs_;
+    }
+
+    std::uint64_t count() const { return count_; }
+    std::uint64_t total_ns() const { return totalNs_; }
+    std::uint64_t max_ns() const { return maxNs_; }
+
+    /* Index of the bucket holding v; the last one holds everything from 31 * 2^40 ns up. */
+    static constexpr std::size_t bucket_of(std::uint64_t v) {
+        if (v < 2 * kSubBuckets) return static_cast<std::size_t>(v);
+        int e = 63 - __builtin_clzll(v);
+        if (e >= kMaxExponent) return kBuckets - 1; // 2^45 ns and up
+        std::uint64_t sub = (v >> (e - kSubBits)) & (kSubBuckets - 1);
+        return static_cast<std::size_t>((e - kSubBits + 1) * kSubBuckets + sub);
+    }
+
+private:
+    /* Largest value that falls into bucket i. */
+    static std::uint64_t bucket_upper(std::size_t i) {
+        if (i < 2 * kSubBuckets) return i;
+        if (i == kBuckets - 1) return UINT64_MAX; // Open-ended: quantile() clamps it to maxNs_
+        int e = static_cast<int>(i / kSubBuckets) + kSubBits - 1;
+        std::uint64_t sub = i % kSubBuckets;
+        std::uint64_t width = std::uint64_t(1) << (e - kSubBits);
+        return (std::uint64_t(1) << e) + (sub + 1) * width - 1;
+    }
+
+    std::array<std::uint64_t, kBuckets> counts_{};
+    std::uint64_t count_ = 0;
+    std::uint64_t totalNs_ = 0;
+    std::uint64_t maxNs_ = 0;
+};
+
+static_assert(LatencyHistogram::bucket_of((std::uint64_t(1) << LatencyHistogram::kMaxExponent) - 1) == LatencyHistogram::kBuckets - 1);
+static_assert(LatencyHistogram::bucket_of(std::uint64_t(1) << LatencyHistogram::kMaxExponent) == LatencyHistogram::kBuckets - 1);
+static_assert(LatencyHistogram::bucket_of(UINT64_MAX) == LatencyHistogram::kBuckets - 1);
+
+/* Set from --latency: -T durations are parsed and recorded in LatencyHistograms. */
+bool trackLatency = false;
+
+/* Set from --errors: failed calls are counted per errno. */
+bool trackErrnos = false;
+
+/*
+ * Set from --cache: durations and errnos are parsed for the sidecar's
+ * columns even when this run does not report them. They are only recorded
+ * in histograms and errno tables when trackLatency / trackErrnos say so.
+ */
+bool captureRows = false;
+
+/*
+ * TimeSeries counts calls and failures per syscall in fixed-width time
+ * buckets for --timeline. Each syscall that occurs gets its own column,
+ * stored as pages of kPageBuckets buckets: only the pages a syscall has calls
+ * in are allocated, so a stray or wrapped timestamp far from the rest costs
+ * one page, not every bucket in between. Syscalls outside the known table
+ * share the "other" column, kSyscallCount.
+ */
+class TimeSeries {
+public:
+    static constexpr std::uint64_t kPageBuckets = 1024;
+
+    /* Calls and failures in kPageBuckets consecutive buckets. */
+    struct Page {
+        std::array<std::uint32_t, kPageBuckets> counts{};
+        std::array<std::uint32_t, kPageBuckets> fails{};
+    };
+
+    /* One syscall's series: its pages, keyed by bucket / kPageBuckets. */
+    struct Column {
+        std::map<std::uint64_t, std::unique_ptr<Page>> pages;
+        std::uint64_t lastKey = UINT64_MAX; // The page used last, so runs of calls skip the map lookup
+        Page *last = nullptr;
+
+        Page &page(std::uint64_t key) {
+            if (key != lastKey) {
+                std::unique_ptr<Page> &p = pages[key];
+                if (!p) p = std::make_unique<Page>();
+                last = p.get();
+                lastKey = key;
+            }
+            return *last;
+        }
+    };
+
+    void record(std::size_t slot, std::uint64_t bucket, bool failed) {
+        Page &p = columns_[slot].page(bucket / kPageBuckets);
+        p.counts[bucket % kPageBuckets]++;
+        p.fails[bucket % kPageBuckets] += failed;
     }
 
-    int numThreads = 1;
-    if (argc >= 3) {
-        try {
-            numThreads = std::stoi(argv[2]);
-            if (numThreads <= 0) {
-                std::cerr << "Warning: num_threads must be > 0. Using 1.\n";
-                numThreads = 1;
+    void merge(const TimeSeries &other) {
+        for (std::size_t slot = 0; slot <= kSyscallCount; slot++) {
+            for (const auto &[key, src] : other.columns_[slot].pages) {
+                Page &dst = columns_[slot].page(key);
+                for (std::size_t i = 0; i < kPageBuckets; i++) {
+                    dst.counts[i] += src->counts[i];
+                    dst.fails[i] += src->fails[i];
+                }
             }
-        } catch (...) {
-            std::cerr << "Warning: invalid num_threads. Using 1.\n";
         }
     }
 
-    std::ifstream infile(argv[1]);
-    if (!infile) {
-        std::cerr << "Error: cannot open input file: "
-                  << argv[1] << "\n";
-        return 1;
+    const Column &column(std::size_t slot) const { return columns_[slot]; }
+
+    /* find returns a column's page 'key', or nullptr if it has no calls there. */
+    const Page *find(std::size_t slot, std::uint64_t key) const {
+        auto it = columns_[slot].pages.find(key);
+        return it == columns_[slot].pages.end() ? nullptr : it->second.get();
     }
 
-    /*======================Start of my code (2)=========================*/
-    // Thread-wise analysis
-    WorkQueue workQueue;
+    /* occupied maps every page any call fell in to the buckets [first, end) its calls span. */
+    std::map<std::uint64_t, std::pair<std::uint64_t, std::uint64_t>> occupied() const {
+        std::map<std::uint64_t, std::pair<std::uint64_t, std::uint64_t>> spans;
+        for (const Column &c : columns_) {
+            for (const auto &[key, page] : c.pages) {
+                std::uint64_t lo = 0, hi = kPageBuckets;
+                while (lo < hi && page->counts[lo] == 0) lo++;
+                while (hi > lo && page->counts[hi - 1] == 0) hi--;
+                if (lo == hi) continue;
+                auto [it, added] = spans.try_emplace(key, key * kPageBuckets + lo, key * kPageBuckets + hi);
+                if (added) continue;
+                it->second.first = std::min(it->second.first, key * kPageBuckets + lo);
+                it->second.second = std::max(it->second.second, key * kPageBuckets + hi);
+            }
+        }
+        return spans;
+    }
 
-    std::vector<std::thread> threads; // Store an Array of active Threads
-    std::vector<StatsMap> statsMapArray(numThreads); // Create a StatsMap for each thread
+    /*
+     * midnight_cut looks for the point where -t/-tt clock times, which restart
+     * at 0 every midnight, wrapped round: when every call lies within the
+     * first 'day' buckets and there is a gap of over half a day between two
+     * of them, the calls after the gap came first. Returns the first bucket
+     * after the widest such gap, or 0 if the series does not wrap.
+     */
+    std::uint64_t midnight_cut(std::uint64_t day) const {
+        auto spans = occupied();
+        if (spans.empty() || std::prev(spans.end())->second.second > day) return 0; // Empty, or -ttt epoch times
+        std::uint64_t cut = 0, widest = 0, prevEnd = spans.begin()->second.first;
+        for (const auto &[key, span] : spans) {
+            if (span.first - prevEnd > widest) {
+                widest = span.first - prevEnd;
+                cut = span.first;
+            }
+            prevEnd = span.second;
+        }
+        return widest * 2 > day ? cut : 0;
+    }
 
-    threads.reserve(numThreads); // Reserve (numThreads) threads for use
-    for(int i = 0; i < numThreads; i++){
-        threads.emplace_back([&workQueue, &statsMapArray, i](){ // Add [numThreads] threads to the threads array with pointers to the workQueue and StatsMap, and an index
-            std::string line;
-            statsMapArray[i].reserve(1000); // Reserve memory for the StatsMaps
-            while(workQueue.pop(line)){ // Loop whilst the workQueue is not (empty and closed). This is how the threads wait for work.
-                std::string syscall;
-                int result;
-                if(parse_line(line, syscall, result)){ // Parse the line from pop ...
-                    update_stats(statsMapArray[i], syscall, result); // ... and if it's successful update the StatsMap
+    /* shift_below moves every bucket before 'cut' up by 'by' buckets. */
+    void shift_below(std::uint64_t cut, std::uint64_t by) {
+        for (Column &c : columns_) {
+            if (c.pages.empty() || c.pages.begin()->first * kPageBuckets >= cut) continue;
+            Column moved;
+            for (const auto &[key, page] : c.pages) {
+                for (std::uint64_t i = 0; i < kPageBuckets; i++) {
+                    if (page->counts[i] == 0) continue;
+                    std::uint64_t bucket = key * kPageBuckets + i;
+                    if (bucket < cut) bucket += by;
+                    Page &dst = moved.page(bucket / kPageBuckets);
+                    dst.counts[bucket % kPageBuckets] += page->counts[i];
+                    dst.fails[bucket % kPageBuckets] += page->fails[i];
                 }
             }
+            c = std::move(moved);
+        }
+    }
+
+private:
+    std::array<Column, kSyscallCount + 1> columns_;
+};
+
+/* Set from --timeline: bucket width in nanoseconds, 0 when timestamps are not bucketed. */
+std::uint64_t timelineBucketNs = 0;
+
+/*
+ * TopK is a Space-Saving sketch (Metwally et al.) of the most frequent keys
+ * in a stream, held in at most 'capacity' entries however many distinct keys
+ * the stream has. A key that finds the sketch full takes over the entry with
+ * the smallest count and inherits that count as its possible overestimate,
+ * so a key's true count lies in [count - error, count], and any key seen
+ * more than N / capacity times out of N is certain to be held. The entries
+ * stay in fixed slots and a binary min-heap of slots orders them by count,
+ * so an update or an eviction costs O(log capacity).
+ */
+class TopK {
+public:
+    struct Entry {
+        std::string key;
+        std::uint64_t count = 0;
+        std::uint64_t error = 0; // 'count' overstates the true count by at most this
+        std::uint64_t fails = 0; // Failures counted since the key took the entry
+    };
+
+    explicit TopK(std::size_t capacity) : capacity_(capacity) {
+        entries_.reserve(capacity_); // Never reallocated: index_ holds views of the keys
+    }
+    TopK(const TopK &) = delete;
+    TopK &operator=(const TopK &) = delete;
+
+    void add(std::string_view key, bool failed) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            Entry &e = entries_[it->second];
+            e.count++;
+            e.fails += failed;
+            sift_down(pos_[it->second]);
+            return;
+        }
+        if (entries_.size() < capacity_) {
+            std::uint32_t slot = static_cast<std::uint32_t>(entries_.size());
+            entries_.push_back(Entry{std::string(key), 1, 0, failed});
+            index_.emplace(entries_[slot].key, slot);
+            heap_.push_back(slot);
+            pos_.push_back(static_cast<std::uint32_t>(heap_.size() - 1));
+            sift_up(heap_.size() - 1);
+            return;
+        }
+        std::uint32_t slot = heap_[0]; // Evict the smallest count
+        Entry &e = entries_[slot];
+        index_.erase(e.key);
+        e.key.assign(key);
+        e.error = e.count;
+        e.count++;
+        e.fails = failed;
+        index_.emplace(e.key, slot);
+        sift_down(0);
+    }
+
+    /*
+     * merge folds 'other' into this sketch. A key missing from one side may
+     * still have occurred there up to that side's smallest count (if it was
+     * full), which is added to both its count and its error; the 'capacity'
+     * largest results are kept.
+     */
+    void merge(const TopK &other) {
+        std::uint64_t ownMin = min_count(), otherMin = other.min_count();
+        std::vector<Entry> merged;
+        merged.reserve(entries_.size() + other.entries_.size());
+        for (const Entry &e : entries_) {
+            auto it = other.index_.find(e.key);
+            if (it == other.index_.end()) {
+                merged.push_back(Entry{e.key, e.count + otherMin, e.error + otherMin, e.fails});
+            } else {
+                const Entry &o = other.entries_[it->second];
+                merged.push_back(Entry{e.key, e.count + o.count, e.error + o.error, e.fails + o.fails});
+            }
+        }
+        for (const Entry &o : other.entries_) {
+            if (!index_.contains(o.key)) merged.push_back(Entry{o.key, o.count + ownMin, o.error + ownMin, o.fails});
+        }
+        if (merged.size() > capacity_) {
+            std::nth_element(merged.begin(), merged.begin() + capacity_ - 1, merged.end(),
+                             [](const Entry &a, const Entry &b) { return a.count > b.count; });
+            merged.resize(capacity_);
+        }
+        rebuild(std::move(merged));
+    }
+
+    /* top returns up to k entries, largest count first. */
+    std::vector<const Entry *> top(std::size_t k) const {
+        std::vector<const Entry *> out;
+        for (const Entry &e : entries_) out.push_back(&e);
+        std::sort(out.begin(), out.end(), [](const Entry *a, const Entry *b) {
+            return a->count != b->count ? a->count > b->count : a->key < b->key;
         });
+        if (out.size() > k) out.resize(k);
+        return out;
     }
 
-    std::string line;
-    while(std::getline(infile, line)){
-        workQueue.push(line);  // Push lines from the input to the queue
+private:
+    /* The count a key absent from the sketch may have reached: 0 until the sketch is full. */
+    std::uint64_t min_count() const {
+        return entries_.size() < capacity_ ? 0 : entries_[heap_[0]].count;
     }
 
-    workQueue.close(); // Close the workQueue. Wake up the threads so they can finish popping.
+    void swap_heap(std::size_t a, std::size_t b) {
+        std::swap(heap_[a], heap_[b]);
+        pos_[heap_[a]] = static_cast<std::uint32_t>(a);
+        pos_[heap_[b]] = static_cast<std::uint32_t>(b);
+    }
 
-    for(auto &t : threads){
-        t.join(); // Rejoin all of the threads
+    std::uint64_t heap_count(std::size_t i) const { return entries_[heap_[i]].count; }
+
+    void sift_up(std::size_t i) {
+        while (i > 0 && heap_count(i) < heap_count((i - 1) / 2)) {
+            swap_heap(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
     }
 
-    // Aggregate per-thread StatsMaps into a single StatsMap
-    StatsMap finalStats;
-    for(const auto &statsMap : statsMapArray){
-        for(const auto &pair : statsMap){ 
-            // Merge Stats from all the threads into a single StatsMap (finalStats):
-            Stats &dst = finalStats[pair.first]; // If the syscall doesn't exist yet, create it
-            dst.count += pair.second.count; // Add the count
-            dst.fails += pair.second.fails; // Add the fails
+    void sift_down(std::size_t i) {
+        for (;;) {
+            std::size_t least = i, l = 2 * i + 1, r = l + 1;
+            if (l < heap_.size() && heap_count(l) < heap_count(least)) least = l;
+            if (r < heap_.size() && heap_count(r) < heap_count(least)) least = r;
+            if (least == i) return;
+            swap_heap(i, least);
+            i = least;
         }
     }
 
-    print_stats(finalStats); // Print result
+    void rebuild(std::vector<Entry> entries) {
+        index_.clear();
+        entries_ = std::move(entries);
+        entries_.reserve(capacity_);
+        heap_.resize(entries_.size());
+        pos_.resize(entries_.size());
+        for (std::uint32_t slot = 0; slot < entries_.size(); slot++) {
+            index_.emplace(entries_[slot].key, slot);
+            heap_[slot] = pos_[slot] = slot;
+        }
+        for (std::size_t i = heap_.size() / 2; i-- > 0;) sift_down(i);
+    }
+
+    std::size_t capacity_;
+    std::vector<Entry> entries_; // Fixed slots
+    std::vector<std::uint32_t> heap_; // Slots, min-heap on count
+    std::vector<std::uint32_t> pos_;  // Slot -> position in heap_
+    std::unordered_map<std::string_view, std::uint32_t> index_; // Key -> slot
+};
+
+/* Set from --top: how many arguments to report per syscall, 0 when arguments are not parsed. */
+std::size_t topK = 0;
+
+/* Entries each per-worker TopK holds, a multiple of --top so that the reported ranks are reliable. */
+std::size_t top_capacity() {
+    return std::max<std::size_t>(4 * topK, 64);
+}
+
+/* Which argument of a syscall --top tracks: its first string (a path), or its first argument (an fd). */
+enum ArgKind : std::uint8_t { kNoArg, kPathArg, kFdArg };
+
+constexpr std::string_view kPathSyscalls[] = {
+    "open", "creat", "stat", "lstat", "access", "execve", "truncate", "chdir",
+    "rename", "mkdir", "rmdir", "link", "unlink", "symlink", "readlink", "chmod",
+    "chown", "lchown", "utime", "utimes", "mknod", "uselib", "statfs", "chroot",
+    "mount", "umount2", "swapon", "swapoff", "acct", "setxattr", "lsetxattr",
+    "getxattr", "lgetxattr", "listxattr", "llistxattr", "removexattr",
+    "lremovexattr", "inotify_add_watch", "openat", "mkdirat", "mknodat",
+    "fchownat", "futimesat", "newfstatat", "unlinkat", "renameat", "linkat",
+    "symlinkat", "readlinkat", "fchmodat", "faccessat", "utimensat",
+    "name_to_handle_at", "renameat2", "execveat", "statx", "open_tree",
+    "move_mount", "fspick", "openat2", "faccessat2", "mount_setattr",
+    "fchmodat2", "mq_open", "mq_unlink", "memfd_create",
+};
+
+constexpr std::string_view kFdSyscalls[] = {
+    "read", "write", "close", "fstat", "lseek", "ioctl", "pread64", "pwrite64",
+    "readv", "writev", "dup", "dup2", "dup3", "sendfile", "connect", "accept",
+    "accept4", "sendto", "recvfrom", "sendmsg", "recvmsg", "sendmmsg",
+    "recvmmsg", "shutdown", "bind", "listen", "getsockname", "getpeername",
+    "setsockopt", "getsockopt", "fcntl", "flock", "fsync", "fdatasync",
+    "ftruncate", "getdents", "getdents64", "fchdir", "fchmod", "fchown",
+    "fstatfs", "fgetxattr", "fsetxattr", "flistxattr", "fremovexattr",
+    "readahead", "fadvise64", "epoll_wait", "epoll_ctl", "epoll_pwait",
+    "epoll_pwait2", "fallocate", "sync_file_range", "preadv", "pwritev",
+    "preadv2", "pwritev2", "syncfs", "splice", "tee", "copy_file_range",
+    "timerfd_settime", "timerfd_gettime", "io_uring_enter",
+};
+
+/* kArgKinds maps a dense syscall ID to the argument --top tracks for it. */
+constexpr auto kArgKinds = []{
+    std::array<ArgKind, kSyscallCount> kinds{};
+    for (std::string_view name : kPathSyscalls) kinds[syscall_id(name)] = kPathArg;
+    for (std::string_view name : kFdSyscalls) kinds[syscall_id(name)] = kFdArg;
+    return kinds;
+}();
+
+/* Longer keys are cut here, so one entry never holds more than this. */
+constexpr std::size_t kMaxArgKey = 256;
+
+/*
+ * arg_key picks the argument to track out of 'args', the text between a
+ * call's '(' and its result: the first quoted string (as strace escaped it,
+ * without the quotes) or everything before the first ',' or ')'. Returns an
+ * empty view if there is none, e.g. for utimensat(3, NULL, ...).
+ */
+std::string_view arg_key(std::string_view args, ArgKind kind) {
+    std::string_view key;
+    if (kind == kPathArg) {
+        std::size_t open = args.find('"');
+        if (open == std::string_view::npos) return {};
+        std::size_t close = open + 1;
+        while (close < args.size() && args[close] != '"') close += (args[close] == '\\') ? 2 : 1;
+        key = args.substr(open + 1, std::min(close, args.size()) - open - 1);
+    } else {
+        key = args.substr(0, args.find_first_of(",)"));
+        while (!key.empty() && key.back() == ' ') key.remove_suffix(1);
+    }
+    return key.substr(0, kMaxArgKey);
+}
+
+/*
+ * SplitHalf is one half of a call that strace -f split into "<unfinished ...>"
+ * and "<... resumed>" lines and that could not be paired within the chunk it
+ * was parsed in. merge_all pairs the halves of all chunks by pid and time.
+ */
+struct SplitHalf {
+    int pid;
+    std::uint64_t timestampNs;
+    std::uint16_t slot = 0; // Resumed halves: syscall ID, kSyscallCount for unknown names
+    bool failed = false;    // Resumed halves: the call returned an error
+};
+
+/* Number of LineFilter stages: --pid, --syscall, --failed-only and --errno. */
+constexpr std::size_t kFilterStages = 4;
+
+/*
+ * RowCapture keeps every counted line a worker parses as one row of columns,
+ * for the --cache sidecar (see write_sidx). Chunk ends are recorded so that a
+ * replay pairs split calls exactly as the parse did. Syscall IDs are dense
+ * IDs, or kSyscallCount + an index into 'names' for unknown names. Every
+ * kSpillRows rows the columns are moved out to temporary files (see
+ * spill_rows), so a worker holds at most about 28 MiB of rows however long
+ * the trace is.
+ */
+constexpr std::size_t kSpillRows = 1 << 20;
+
+struct RowCapture {
+    RowCapture() = default;
+    RowCapture(const RowCapture &) = delete;
+    RowCapture &operator=(const RowCapture &) = delete;
+    ~RowCapture() {
+        for (std::FILE *f : spill) {
+            if (f) std::fclose(f);
+        }
+    }
+
+    /* Rows captured so far, spilled or not. */
+    std::uint64_t size() const { return spilledRows + id.size(); }
+
+    std::vector<std::uint16_t> id;
+    std::vector<std::uint8_t> kind; // RowKind
+    std::vector<std::uint8_t> errnoId;
+    std::vector<std::int32_t> result;
+    std::vector<std::int32_t> pid;
+    std::vector<std::uint64_t> timestampNs; // kNoValue if the line had no timestamp
+    std::vector<std::uint64_t> durationNs;  // kNoValue if the line had no -T duration
+    std::vector<std::uint64_t> chunkEnds;   // Row count at the end of each chunk
+    std::vector<std::string> names;
+    std::unordered_map<std::string, std::uint16_t, StringHash, std::equal_to<>> nameIds;
+    bool overflow = false; // Too many unknown names for 16-bit IDs; the cache is not written
+    std::array<std::FILE *, 7> spill{}; // One per column, in for_each_row_column order
+    std::uint64_t spilledRows = 0;
+    bool spillFailed = false; // A temporary file could not be written; the cache is not written
+};
+
+/* for_each_row_column calls fn(index, &RowCapture::column) for each per-row column, in sidecar order. */
+template <typename Fn>
+void for_each_row_column(Fn fn) {
+    fn(0, &RowCapture::id);
+    fn(1, &RowCapture::kind);
+    fn(2, &RowCapture::errnoId);
+    fn(3, &RowCapture::result);
+    fn(4, &RowCapture::pid);
+    fn(5, &RowCapture::timestampNs);
+    fn(6, &RowCapture::durationNs);
+}
+
+/* spill_rows appends the rows held in memory to the column files and empties the columns. */
+void spill_rows(RowCapture &rows) {
+    rows.spilledRows += rows.id.size();
+    for_each_row_column([&](std::size_t c, auto member) {
+        auto &values = rows.*member;
+        if (!rows.spill[c]) rows.spill[c] = std::tmpfile(); // Unlinked already, gone when closed
+        if (!rows.spill[c] || std::fwrite(values.data(), sizeof(values[0]), values.size(), rows.spill[c]) != values.size()) {
+            rows.spillFailed = true;
+        }
+        values.clear();
+    });
+}
+
+enum RowKind : std::uint8_t { kCall, kResumedHalf, kUnfinishedHalf };
+constexpr std::uint64_t kNoValue = UINT64_MAX;
+
+class SharedStats;
+
+void update_stats(StatsMap &stats, std::string_view syscall, int result) {
+    auto it = stats.find(syscall);
+    if (it == stats.end()) {
+        it = stats.emplace(std::string(syscall), Stats{}).first; // Only a new name allocates
+    }
+    Stats &s = it->second;
+    s.count++;
+    if (result < 0) {
+        s.fails++;
+    }
+}
+
+/*
+ * SyscallStats is the statistics table each worker fills: a flat array
+ * indexed by dense syscall ID, plus a StatsMap for names outside the table.
+ */
+struct SyscallStats {
+    std::array<Stats, kSyscallCount> known{};
+    StatsMap unknown;
+    PidStats byPid;
+    // --latency: histograms are created the first time a syscall is timed, so
+    // untimed syscalls (and runs without --latency) cost only a null pointer
+    std::array<std::unique_ptr<LatencyHistogram>, kSyscallCount> knownLatency;
+    std::unordered_map<std::string, LatencyHistogram, StringHash, std::equal_to<>> unknownLatency;
+    TimeSeries timeline; // --timeline
+    // --errors: allocated on a syscall's first failure, like the histograms
+    std::array<std::unique_ptr<ErrnoCounts>, kSyscallCount> knownErrnos;
+    std::unordered_map<std::string, ErrnoCounts, StringHash, std::equal_to<>> unknownErrnos;
+    // --timeline: split calls whose halves fell into different chunks, not yet in 'timeline'
+    std::vector<SplitHalf> unfinishedHalves;
+    std::vector<SplitHalf> resumedHalves;
+    std::unique_ptr<RowCapture> rows; // --cache: set while a sidecar is being built
+    std::array<std::uint64_t, kFilterStages> skipped{}; // Lines dropped at each filter stage
+    // --top: one sketch per syscall in kArgKinds that was seen with an argument
+    std::array<std::unique_ptr<TopK>, kSyscallCount> topArgs;
+    // kProfile: lines this table's worker was given, and how many of them could not be parsed
+    std::uint64_t linesSeen = 0;
+    std::uint64_t parseFailures = 0;
+    // --aggregate=shared: calls are counted in slot 'sharedSlot' of this table
+    // instead of in known, unknown and byPid
+    SharedStats *shared = nullptr;
+    std::size_t sharedSlot = 0;
+};
+
+
+/*
+ * SharedStats is the --aggregate=shared alternative to per-thread tables
+ * merged after join(): every worker adds its call counts into this one
+ * table, which a reporter thread can snapshot() while they keep writing.
+ *
+ *   - Known syscalls are counted in per-worker slots, each on its own cache
+ *     lines. A slot has a single writer, so an add is a relaxed load and a
+ *     release store, with no locked instruction and no line bouncing.
+ *   - Unknown names and --per-pid entries, which are keyed by string or by
+ *     pid, live in lock-striped maps: the pid stripes are the kPidShards of
+ *     PidStats, so each (pid, syscall) is held once however many workers see
+ *     it, and a stripe's mutex is only contended when two workers hit it at
+ *     the same moment.
+ *
+ * Counts are stored before fails and snapshot() loads fails first, so no
+ * syscall in a snapshot shows more failures than calls; every figure is one
+ * the counter actually held, later snapshots never go backwards, and once
+ * the workers have stopped a snapshot is exact.
+ */
+class SharedStats {
+public:
+    explicit SharedStats(std::size_t workers)
+        : workers_(workers), slots_(std::make_unique<Slot[]>(workers)) {}
+
+    std::size_t workers() const { return workers_; }
+
+    /* attach points statsArray[i] at slot i, so its worker counts into this table. */
+    void attach(std::vector<SyscallStats> &statsArray) {
+        for (std::size_t i = 0; i < statsArray.size() && i < workers_; i++) {
+            statsArray[i].shared = this;
+            statsArray[i].sharedSlot = i;
+        }
+    }
+
+    /* record counts one call, from the worker owning 'slot'. */
+    void record(std::size_t slot, int id, std::string_view syscall, std::uint32_t pid, bool failed) {
+        if (trackPids) {
+            std::size_t pidSlot = (id == kUnknownSyscall) ? kSyscallCount : id;
+            PidStripe &stripe = pids_[pid_shard(pid)];
+            std::lock_guard<std::mutex> lock(stripe.lock);
+            Stats &p = stripe.pids[pid_key(pid, pidSlot)];
+            p.count++;
+            p.fails += failed;
+        }
+        if (id == kUnknownSyscall) {
+            NameStripe &stripe = names_[name_stripe(syscall)];
+            std::lock_guard<std::mutex> lock(stripe.lock);
+            update_stats(stripe.names, syscall, failed ? -1 : 0);
+            return;
+        }
+        Counter &c = slots_[slot].known[id];
+        add(c.count, 1);
+        if (failed) add(c.fails, 1);
+    }
+
+    /* add_counts adds the call counts of a private table (a per-file or per-chunk one) into 'slot'. */
+    void add_counts(std::size_t slot, const SyscallStats &src) {
+        for (std::size_t id = 0; id < kSyscallCount; id++) {
+            if (src.known[id].count == 0) continue;
+            Counter &c = slots_[slot].known[id];
+            add(c.count, src.known[id].count);
+            add(c.fails, src.known[id].fails);
+        }
+        for (const auto &pair : src.unknown) {
+            NameStripe &stripe = names_[name_stripe(pair.first)];
+            std::lock_guard<std::mutex> lock(stripe.lock);
+            Stats &s = stripe.names[pair.first];
+            s.count += pair.second.count;
+            s.fails += pair.second.fails;
+        }
+    }
+
+    void add_pids(const PidStats &src) {
+        for (std::size_t shard = 0; shard < kPidShards; shard++) {
+            if (src.shards[shard].empty()) continue;
+            std::lock_guard<std::mutex> lock(pids_[shard].lock);
+            for (const auto &pair : src.shards[shard]) {
+                Stats &s = pids_[shard].pids[pair.first];
+                s.count += pair.second.count;
+                s.fails += pair.second.fails;
+            }
+        }
+    }
+
+    /* snapshot copies the counts into a SyscallStats; it may run while workers are recording. */
+    SyscallStats snapshot() const {
+        SyscallStats out;
+        for (std::size_t id = 0; id < kSyscallCount; id++) {
+            for (std::size_t w = 0; w < workers_; w++) {
+                const Counter &c = slots_[w].known[id];
+                std::uint64_t fails = c.fails.load(std::memory_order_acquire);
+                out.known[id].fails += fails;
+                out.known[id].count += c.count.load(std::memory_order_acquire);
+            }
+        }
+        for (const NameStripe &stripe : names_) {
+            std::lock_guard<std::mutex> lock(stripe.lock);
+            for (const auto &pair : stripe.names) out.unknown.insert(pair);
+        }
+        if (trackPids) {
+            for (std::size_t shard = 0; shard < kPidShards; shard++) {
+                std::lock_guard<std::mutex> lock(pids_[shard].lock);
+                out.byPid.shards[shard] = pids_[shard].pids;
+            }
+        }
+        return out;
+    }
+
+    /* reset clears every count. Only call it while no worker is recording. */
+    void reset() {
+        slots_ = std::make_unique<Slot[]>(workers_);
+        for (NameStripe &stripe : names_) stripe.names.clear();
+        for (PidStripe &stripe : pids_) stripe.pids.clear();
+    }
+
+private:
+    static constexpr std::size_t kNameStripes = 16;
+
+    struct Counter {
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<std::uint64_t> fails{0};
+    };
+    struct alignas(kCacheLine) Slot {
+        std::array<Counter, kSyscallCount> known;
+    };
+    struct alignas(kCacheLine) NameStripe {
+        mutable std::mutex lock;
+        StatsMap names;
+    };
+    struct alignas(kCacheLine) PidStripe {
+        mutable std::mutex lock;
+        std::unordered_map<std::uint64_t, Stats> pids;
+    };
+
+    /* add is only called by a slot's own worker, so it needs no read-modify-write instruction. */
+    static void add(std::atomic<std::uint64_t> &counter, std::uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    static std::size_t name_stripe(std::string_view name) {
+        return StringHash{}(name) % kNameStripes;
+    }
+
+    std::size_t workers_;
+    std::unique_ptr<Slot[]> slots_;
+    std::array<NameStripe, kNameStripes> names_;
+    std::array<PidStripe, kPidShards> pids_;
+};
+
+
+/*
+ * Outcome of parse_line; anything other than Ok means the line is not counted.
+ * Unfinished lines are only used to pair up split calls (see count_line).
+ */
+enum class ParseStatus {
+    Ok,
+    NoSyscall,  // no '(' on the line
+    NoResult,   // no '=' or nothing after it
+    BadResult,  // result is not an integer, e.g. "= ?"
+    Unfinished, // first half of a call strace -f split in two: "read(3, <unfinished ...>"
+    // Dropped by a LineFilter, at the stage named
+    FilteredPid,
+    FilteredSyscall,
+    FilteredFailed,
+    FilteredErrno,
+};
+
+/* The option behind each filter stage, in the order parse_fields applies them. */
+constexpr std::string_view kFilterStageNames[kFilterStages] = {"--pid", "--syscall", "--failed-only", "--errno"};
+
+constexpr bool is_filtered(ParseStatus status) {
+    return status >= ParseStatus::FilteredPid;
+}
+
+constexpr std::size_t filter_stage(ParseStatus status) {
+    return static_cast<std::size_t>(status) - static_cast<std::size_t>(ParseStatus::FilteredPid);
+}
+
+/*
+ * ParsedLine holds the fields of one trace line. 'syscall' is a view into the
+ * line that was parsed, so it is only valid while that buffer is.
+ */
+struct ParsedLine {
+    std::string_view syscall;
+    int result = 0;
+    int pid = 0; // From a "[pid N] " or "N " prefix (strace -f); 0 if there was none
+    bool resumed = false; // "<... read resumed>": the second half of a split call
+    bool timed = false; // The line ended in a strace -T duration ...
+    std::uint64_t durationNs = 0; // ... of this many nanoseconds
+    bool stamped = false; // The line started with a strace -t/-tt/-ttt timestamp ...
+    std::uint64_t timestampNs = 0; // ... of this many nanoseconds (see parse_timestamp)
+    std::size_t errnoId = kOtherErrno; // With --errors, the errno a failed call returned
+    std::string_view args; // With --top, the text between '(' and the last '='; empty for resumed halves
+};
+
+
+/*
+ * LineFilter holds the --pid, --syscall, --failed-only and --errno
+ * predicates. parse_fields tests each one as soon as the field it needs has
+ * been read, so the errno, duration and arguments of a line that cannot
+ * match are never parsed; the syscall test starts with a lookup of the
+ * name's first byte. A line is only reported as skipped if it would
+ * otherwise have been counted (or is an unfinished half), the same lines
+ * check() sees under --cache.
+ */
+struct LineFilter {
+    bool byPid = false;
+    std::vector<int> pids; // Sorted
+    bool bySyscall = false;
+    std::bitset<256> firstBytes; // First characters of the wanted names
+    std::bitset<kSyscallCount> syscalls;
+    std::vector<std::string> otherSyscalls; // Wanted names outside the table
+    bool failedOnly = false;
+    bool byErrno = false;
+    std::bitset<kErrnoCount + 1> errnos;
+
+    bool active() const { return byPid || bySyscall || failedOnly || byErrno; }
+
+    bool wants_pid(int pid) const {
+        return std::binary_search(pids.begin(), pids.end(), pid);
+    }
+
+    bool wants_syscall(std::string_view name) const {
+        if (name.empty() || !firstBytes[static_cast<unsigned char>(name[0])]) return false;
+        int id = syscall_id(name);
+        if (id != kUnknownSyscall) return syscalls[id];
+        return std::find(otherSyscalls.begin(), otherSyscalls.end(), name) != otherSyscalls.end();
+    }
+
+    /* check applies the filter to a line that has already been parsed in full. */
+    ParseStatus check(const ParsedLine &parsed, ParseStatus status) const {
+        if (status != ParseStatus::Ok && status != ParseStatus::Unfinished) return status;
+        if (byPid && !wants_pid(parsed.pid)) return ParseStatus::FilteredPid;
+        if (bySyscall && !wants_syscall(parsed.syscall)) return ParseStatus::FilteredSyscall;
+        if (status == ParseStatus::Unfinished) return status;
+        if (failedOnly && parsed.result >= 0) return ParseStatus::FilteredFailed;
+        if (byErrno && (parsed.result >= 0 || !errnos[parsed.errnoId])) return ParseStatus::FilteredErrno;
+        return status;
+    }
+};
+
+/*
+ * lineFilter is applied by parse_fields while it parses. With --cache the
+ * filter is moved to rowFilter instead, which count_line applies after a
+ * line has been captured, so that the sidecar still holds every line.
+ */
+LineFilter lineFilter;
+LineFilter rowFilter;
+
+
+/*
+ * parse_pid_prefix reads the pid that strace -f puts in front of a call,
+ * either "[pid 1234] " (output to a terminal) or "1234  " (with -o). Returns
+ * the offset where the rest of the line starts, 0 if there is no prefix.
+ */
+std::size_t parse_pid_prefix(std::string_view line, int &pid) {
+    pid = 0;
+    std::size_t pos = 0;
+    bool bracket = line.compare(0, 5, "[pid ") == 0;
+    if (bracket) {
+        pos = line.find_first_not_of(' ', 5);
+        if (pos == std::string_view::npos) return 0;
+    }
+    auto [ptr, ec] = std::from_chars(line.data() + pos, line.data() + line.size(), pid);
+    std::size_t end = ptr - line.data();
+    if (ec != std::errc() || end >= line.size() || line[end] != (bracket ? ']' : ' ')) {
+        pid = 0; // Not a pid, e.g. a -tt timestamp such as "10:23:45.123456"
+        return 0;
+    }
+    return line.find_first_not_of(' ', end + 1);
+}
+
+
+/*
+ * parse_seconds reads "S" or "S.fraction" starting at p and converts it to
+ * nanoseconds. Returns the end of the number, or nullptr if there is none.
+ */
+const char *parse_seconds(const char *p, const char *end, std::uint64_t &ns) {
+    std::uint64_t seconds = 0;
+    auto [q, ec] = std::from_chars(p, end, seconds);
+    if (ec != std::errc()) return nullptr;
+    std::uint64_t frac = 0, scale = 1000000000;
+    if (q < end && *q == '.') {
+        for (q++; q < end && *q >= '0' && *q <= '9'; q++) {
+            if (scale > 1) { // Digits past nanoseconds are ignored
+                scale /= 10;
+                frac += (*q - '0') * scale;
+            }
+        }
+    }
+    ns = seconds * 1000000000 + frac;
+    return q;
+}
+
+
+/*
+ * parse_duration reads the "<0.000123>" that strace -T appends to a line and
+ * converts it to nanoseconds. Returns false if the line has no duration.
+ */
+bool parse_duration(std::string_view line, std::uint64_t &ns) {
+    while (!line.empty() && (line.back() == ' ' || line.back() == '\r')) line.remove_suffix(1);
+    if (line.empty() || line.back() != '>') return false;
+    std::size_t open = line.rfind('<');
+    if (open == std::string_view::npos) return false;
+
+    const char *end = line.data() + line.size() - 1;
+    return parse_seconds(line.data() + open + 1, end, ns) == end;
+}
+
+
+/*
+ * parse_timestamp reads the time strace -t/-tt/-ttt puts in front of a call,
+ * "10:23:45", "10:23:45.123456" or "1700000000.123456", starting at 'pos'.
+ * The clock forms are converted to nanoseconds since midnight and -ttt to
+ * nanoseconds since the epoch. Returns the offset where the rest of the line
+ * starts, or 'pos' if there is no timestamp there.
+ */
+std::size_t parse_timestamp(std::string_view line, std::size_t pos, std::uint64_t &ns) {
+    const char *p = line.data() + pos;
+    const char *end = line.data() + line.size();
+    std::uint64_t hours = 0, minutes = 0;
+    auto [q, ec] = std::from_chars(p, end, hours);
+    if (ec != std::errc() || q == end) return pos;
+    const char *secs = p;
+    if (*q == ':') {
+        auto [r, ec2] = std::from_chars(q + 1, end, minutes);
+        if (ec2 != std::errc() || r == end || *r != ':') return pos;
+        secs = r + 1;
+    } else if (*q == '.') {
+        hours = 0; // -ttt: what we read was the seconds
+    } else {
+        return pos;
+    }
+    q = parse_seconds(secs, end, ns);
+    if (q == nullptr || q == end || *q != ' ') return pos;
+    ns += (hours * 60 + minutes) * 60 * 1000000000;
+    return std::min(line.find_first_not_of(' ', q - line.data()), line.size());
+}
+
+
+/* is_unfinished tells whether 'line' is the first half of a split call, "read(3, <unfinished ...>". */
+bool is_unfinished(std::string_view line) {
+    while (!line.empty() && (line.back() == ' ' || line.back() == '\r')) line.remove_suffix(1);
+    return line.ends_with("<unfinished ...>");
+}
+
+
+/*
+ * parse_fields finishes parsing a line whose first '(' (posOpen) and last '='
+ * (posEq) are already known, e.g. from scan_lines. Either may be npos.
+ */
+ParseStatus parse_fields(std::string_view line, std::size_t posOpen, std::size_t posEq, ParsedLine &out) {
+    if (line.empty()) return ParseStatus::NoSyscall;
+    std::size_t nameStart = 0;
+    if (line[0] == '[' || (line[0] >= '0' && line[0] <= '9')) {
+        nameStart = std::min(parse_pid_prefix(line, out.pid), line.size());
+    } else {
+        out.pid = 0;
+    }
+    // The stage that dropped the line, returned once the result shows the line would have been counted
+    ParseStatus dropped = ParseStatus::Ok;
+    if (lineFilter.byPid && !lineFilter.wants_pid(out.pid)) dropped = ParseStatus::FilteredPid;
+    out.stamped = false;
+    if (nameStart < line.size() && line[nameStart] >= '0' && line[nameStart] <= '9') {
+        std::size_t after = parse_timestamp(line, nameStart, out.timestampNs);
+        out.stamped = (after != nameStart);
+        nameStart = after;
+    }
+    out.resumed = false;
+    if (nameStart < line.size() && line[nameStart] == '<') { // "<... read resumed>, 42) = 42"
+        std::size_t nameEnd = line.find(" resumed>", nameStart);
+        if (line.compare(nameStart, 5, "<... ") == 0 && nameEnd != std::string_view::npos) {
+            out.syscall = line.substr(nameStart + 5, nameEnd - nameStart - 5);
+            out.resumed = true;
+        }
+    }
+    if (!out.resumed) {
+        if (posOpen == std::string_view::npos) return ParseStatus::NoSyscall;
+        nameStart = std::min(nameStart, posOpen);
+        out.syscall = line.substr(nameStart, posOpen - nameStart);
+    }
+    if (dropped == ParseStatus::Ok && lineFilter.bySyscall && !lineFilter.wants_syscall(out.syscall)) {
+        dropped = ParseStatus::FilteredSyscall;
+    }
+    ParseStatus unfinished = (dropped == ParseStatus::Ok) ? ParseStatus::Unfinished : dropped;
+
+    if (posEq == std::string_view::npos) {
+        return is_unfinished(line) ? unfinished : ParseStatus::NoResult;
+    }
+
+    std::size_t resultStart = line.find_first_not_of(" \t", posEq + 1);
+    if (resultStart == std::string_view::npos) return ParseStatus::NoResult;
+
+    const char *first = line.data() + resultStart;
+    const char *last = line.data() + line.size();
+    if (*first == '+' && last - first > 1 && first[1] != '-') first++; // from_chars, unlike stoi, does not accept an explicit '+'
+    auto [ptr, ec] = std::from_chars(first, last, out.result);
+    if (ec != std::errc()) { // not a number, or out of int range
+        return is_unfinished(line) ? unfinished : ParseStatus::BadResult; // e.g. an '=' in the arguments
+    }
+    if (dropped != ParseStatus::Ok) return dropped;
+
+    if (out.result >= 0 && (lineFilter.failedOnly || lineFilter.byErrno)) {
+        return lineFilter.failedOnly ? ParseStatus::FilteredFailed : ParseStatus::FilteredErrno;
+    }
+
+    if (out.result < 0 && (trackErrnos || captureRows || lineFilter.byErrno)) { // e.g. "-1 ENOENT (No such file or directory)"
+        std::string_view rest(ptr, last - ptr);
+        std::size_t errnoStart = rest.find_first_not_of(' ');
+        rest = (errnoStart == std::string_view::npos) ? std::string_view() : rest.substr(errnoStart);
+        out.errnoId = errno_id(rest.substr(0, rest.find(' ')));
+        if (lineFilter.byErrno && !lineFilter.errnos[out.errnoId]) return ParseStatus::FilteredErrno;
+    }
+    out.timed = (trackLatency || captureRows) && parse_duration(line, out.durationNs);
+    if (topK != 0) {
+        out.args = (out.resumed || posEq < posOpen) ? std::string_view() : line.substr(posOpen + 1, posEq - posOpen - 1);
+    }
+    return ParseStatus::Ok;
+}
+
+
+ParseStatus parse_line(std::string_view line, ParsedLine &out) {
+    return parse_fields(line, line.find('('), line.rfind('='), out);
+}
+
+
+void update_stats(SyscallStats &stats, const ParsedLine &parsed) {
+    int id = syscall_id(parsed.syscall);
+    if (stats.shared) {
+        stats.shared->record(stats.sharedSlot, id, parsed.syscall, parsed.pid, parsed.result < 0);
+    } else if (trackPids) {
+        std::size_t slot = (id == kUnknownSyscall) ? kSyscallCount : id;
+        Stats &p = stats.byPid.shards[pid_shard(parsed.pid)][pid_key(parsed.pid, slot)];
+        p.count++;
+        p.fails += (parsed.result < 0);
+    }
+    if (timelineBucketNs != 0 && parsed.stamped) {
+        std::size_t slot = (id == kUnknownSyscall) ? kSyscallCount : id;
+        stats.timeline.record(slot, parsed.timestampNs / timelineBucketNs, parsed.result < 0);
+    }
+    if (parsed.timed && trackLatency) {
+        LatencyHistogram *h;
+        if (id == kUnknownSyscall) {
+            auto it = stats.unknownLatency.find(parsed.syscall);
+            if (it == stats.unknownLatency.end()) it = stats.unknownLatency.emplace(std::string(parsed.syscall), LatencyHistogram{}).first;
+            h = &it->second;
+        } else {
+            if (!stats.knownLatency[id]) stats.knownLatency[id] = std::make_unique<LatencyHistogram>();
+            h = stats.knownLatency[id].get();
+        }
+        h->record(parsed.durationNs);
+    }
+    if (id == kUnknownSyscall) {
+        if (!stats.shared) update_stats(stats.unknown, parsed.syscall, parsed.result);
+        if (parsed.result < 0 && trackErrnos) {
+            auto it = stats.unknownErrnos.find(parsed.syscall);
+            if (it == stats.unknownErrnos.end()) it = stats.unknownErrnos.emplace(std::string(parsed.syscall), ErrnoCounts{}).first;
+            it->second[parsed.errnoId]++;
+        }
+        return;
+    }
+    if (!stats.shared) {
+        Stats &s = stats.known[id];
+        s.count++;
+        s.fails += (parsed.result < 0);
+    }
+    if (parsed.result < 0 && trackErrnos) {
+        if (!stats.knownErrnos[id]) stats.knownErrnos[id] = std::make_unique<ErrnoCounts>();
+        (*stats.knownErrnos[id])[parsed.errnoId]++;
+    }
+    if (topK != 0 && kArgKinds[id] != kNoArg) {
+        std::string_view key = arg_key(parsed.args, kArgKinds[id]);
+        if (key.empty()) return;
+        if (!stats.topArgs[id]) stats.topArgs[id] = std::make_unique<TopK>(top_capacity());
+        stats.topArgs[id]->add(key, parsed.result < 0);
+    }
+}
+
+
+/* capture_row appends a line that count_line is about to use to 'rows'. */
+void capture_row(RowCapture &rows, ParseStatus status, const ParsedLine &parsed) {
+    std::uint16_t id;
+    int known = syscall_id(parsed.syscall);
+    if (known != kUnknownSyscall) {
+        id = static_cast<std::uint16_t>(known);
+    } else {
+        auto it = rows.nameIds.find(parsed.syscall);
+        if (it == rows.nameIds.end()) {
+            if (kSyscallCount + rows.names.size() >= UINT16_MAX) {
+                rows.overflow = true;
+                return;
+            }
+            rows.names.emplace_back(parsed.syscall);
+            it = rows.nameIds.emplace(rows.names.back(), static_cast<std::uint16_t>(rows.names.size() - 1)).first;
+        }
+        id = static_cast<std::uint16_t>(kSyscallCount + it->second);
+    }
+    rows.id.push_back(id);
+    rows.kind.push_back(status == ParseStatus::Unfinished ? kUnfinishedHalf : parsed.resumed ? kResumedHalf : kCall);
+    bool call = (status == ParseStatus::Ok); // Unfinished halves have no result, errno or duration
+    rows.errnoId.push_back(static_cast<std::uint8_t>(call && parsed.result < 0 ? parsed.errnoId : kOtherErrno));
+    rows.result.push_back(call ? parsed.result : 0);
+    rows.pid.push_back(parsed.pid);
+    rows.timestampNs.push_back(parsed.stamped ? parsed.timestampNs : kNoValue);
+    rows.durationNs.push_back(call && parsed.timed ? parsed.durationNs : kNoValue);
+    if (rows.id.size() == kSpillRows) spill_rows(rows);
+}
+
+/* Start times of <unfinished ...> calls in the current chunk, by pid. */
+using PendingCalls = std::unordered_map<int, std::uint64_t>;
+
+/*
+ * count_line adds one parsed line to 'stats'. A split call is counted once,
+ * from its "<... resumed>" half, which carries the name and the result. With
+ * --timeline the call belongs in the bucket of its start, which is on the
+ * "<unfinished ...>" half: 'pending' pairs the halves within a chunk, and
+ * halves left over at the end of it (see end_chunk) are paired by merge_all.
+ */
+void count_line(SyscallStats &stats, ParseStatus status, ParsedLine &parsed, PendingCalls &pending) {
+    if constexpr (kProfile) {
+        stats.linesSeen++;
+        stats.parseFailures += (status == ParseStatus::NoSyscall || status == ParseStatus::NoResult ||
+                                status == ParseStatus::BadResult);
+    }
+    if (stats.rows && (status == ParseStatus::Ok || status == ParseStatus::Unfinished)) {
+        capture_row(*stats.rows, status, parsed);
+    }
+    if (rowFilter.active()) status = rowFilter.check(parsed, status);
+    if (status == ParseStatus::Ok && !parsed.resumed) {
+        update_stats(stats, parsed);
+        return;
+    }
+    if (is_filtered(status)) {
+        stats.skipped[filter_stage(status)]++;
+        return;
+    }
+    if (timelineBucketNs == 0 || !parsed.stamped) {
+        if (status == ParseStatus::Ok) update_stats(stats, parsed);
+        return;
+    }
+    if (status == ParseStatus::Unfinished) {
+        pending[parsed.pid] = parsed.timestampNs;
+        return;
+    }
+    if (status != ParseStatus::Ok) return;
+
+    auto it = pending.find(parsed.pid);
+    if (it != pending.end()) {
+        parsed.timestampNs = it->second;
+        pending.erase(it);
+        update_stats(stats, parsed);
+        return;
+    }
+    int id = syscall_id(parsed.syscall);
+    stats.resumedHalves.push_back(SplitHalf{parsed.pid, parsed.timestampNs,
+                                            static_cast<std::uint16_t>(id == kUnknownSyscall ? kSyscallCount : id),
+                                            parsed.result < 0});
+    parsed.stamped = false; // Counted now, but its bucket is only known once merge_all finds the start
+    update_stats(stats, parsed);
+}
+
+/* end_chunk keeps the calls still unfinished at the end of a chunk for merge_all. */
+void end_chunk(SyscallStats &stats, PendingCalls &pending) {
+    if (stats.rows && (stats.rows->chunkEnds.empty() || stats.rows->chunkEnds.back() != stats.rows->size())) {
+        stats.rows->chunkEnds.push_back(stats.rows->size());
+    }
+    for (const auto &[pid, start] : pending) {
+        stats.unfinishedHalves.push_back(SplitHalf{pid, start});
+    }
+    pending.clear();
+}
+
+/*
+ * pair_split_calls adds the resumed halves in 'stats' to its timeline, each
+ * in the bucket of the latest unfinished half of the same pid that started
+ * before it (a thread has one call in flight at a time). A resumed half whose
+ * start was never seen keeps its own time.
+ */
+void pair_split_calls(SyscallStats &stats) {
+    auto byPidTime = [](const SplitHalf &a, const SplitHalf &b) {
+        return a.pid != b.pid ? a.pid < b.pid : a.timestampNs < b.timestampNs;
+    };
+    std::sort(stats.unfinishedHalves.begin(), stats.unfinishedHalves.end(), byPidTime);
+    for (const SplitHalf &r : stats.resumedHalves) {
+        auto it = std::upper_bound(stats.unfinishedHalves.begin(), stats.unfinishedHalves.end(), r, byPidTime);
+        std::uint64_t start = r.timestampNs;
+        if (it != stats.unfinishedHalves.begin() && std::prev(it)->pid == r.pid) start = std::prev(it)->timestampNs;
+        stats.timeline.record(r.slot, start / timelineBucketNs, r.failed);
+    }
+    stats.unfinishedHalves.clear(); // Calls that never resumed have no result and are not counted
+    stats.resumedHalves.clear();
+}
+
+/*
+ * merge_counts adds everything in 'src' except the per-pid counts into
+ * 'dst': call counts (into dst's SharedStats slot when it has one), skipped
+ * lines, histograms, timeline, errnos and top arguments. merge_all merges
+ * the pid shards separately, in parallel.
+ */
+void merge_counts(SyscallStats &dst, const SyscallStats &src) {
+    dst.linesSeen += src.linesSeen;
+    dst.parseFailures += src.parseFailures;
+    for (std::size_t stage = 0; stage < kFilterStages; stage++) {
+        dst.skipped[stage] += src.skipped[stage];
+    }
+    if (dst.shared) {
+        dst.shared->add_counts(dst.sharedSlot, src);
+    } else {
+        for (std::size_t id = 0; id < kSyscallCount; id++) {
+            dst.known[id].count += src.known[id].count;
+            dst.known[id].fails += src.known[id].fails;
+        }
+        for (const auto &pair : src.unknown) {
+            Stats &s = dst.unknown[pair.first];
+            s.count += pair.second.count;
+            s.fails += pair.second.fails;
+        }
+    }
+    for (std::size_t id = 0; id < kSyscallCount; id++) {
+        if (!src.knownLatency[id]) continue;
+        if (!dst.knownLatency[id]) dst.knownLatency[id] = std::make_unique<LatencyHistogram>();
+        dst.knownLatency[id]->merge(*src.knownLatency[id]);
+    }
+    for (const auto &pair : src.unknownLatency) {
+        dst.unknownLatency[pair.first].merge(pair.second);
+    }
+    if (timelineBucketNs != 0) {
+        dst.timeline.merge(src.timeline);
+        dst.unfinishedHalves.insert(dst.unfinishedHalves.end(), src.unfinishedHalves.begin(), src.unfinishedHalves.end());
+        dst.resumedHalves.insert(dst.resumedHalves.end(), src.resumedHalves.begin(), src.resumedHalves.end());
+    }
+    auto addErrnos = [](ErrnoCounts &d, const ErrnoCounts &s) {
+        for (std::size_t e = 0; e <= kErrnoCount; e++) d[e] += s[e];
+    };
+    for (std::size_t id = 0; id < kSyscallCount; id++) {
+        if (!src.knownErrnos[id]) continue;
+        if (!dst.knownErrnos[id]) dst.knownErrnos[id] = std::make_unique<ErrnoCounts>();
+        addErrnos(*dst.knownErrnos[id], *src.knownErrnos[id]);
+    }
+    for (const auto &pair : src.unknownErrnos) {
+        addErrnos(dst.unknownErrnos.try_emplace(pair.first).first->second, pair.second);
+    }
+    for (std::size_t id = 0; id < kSyscallCount; id++) {
+        if (!src.topArgs[id]) continue;
+        if (!dst.topArgs[id]) dst.topArgs[id] = std::make_unique<TopK>(top_capacity());
+        dst.topArgs[id]->merge(*src.topArgs[id]);
+    }
+}
+
+void merge_pid_shard(PidStats &dst, const PidStats &src, std::size_t shard) {
+    for (const auto &pair : src.shards[shard]) {
+        Stats &s = dst.shards[shard][pair.first];
+        s.count += pair.second.count;
+        s.fails += pair.second.fails;
+    }
+}
+
+/* merge_stats adds every count in 'src' into 'dst'. */
+void merge_stats(SyscallStats &dst, const SyscallStats &src) {
+    merge_counts(dst, src);
+    if (dst.shared) {
+        dst.shared->add_pids(src.byPid);
+        return;
+    }
+    for (std::size_t shard = 0; shard < kPidShards; shard++) {
+        merge_pid_shard(dst.byPid, src.byPid, shard);
+    }
+}
+
+/*
+ * merge_all combines the per-thread tables into one, taking the call counts
+ * from their SharedStats when they have one. The per-pid shards,
+ * which can hold tens of thousands of entries, are merged in parallel: each
+ * shard is one WorkStealer task, so no locking is needed and a merger that
+ * drew small shards takes over the rest of a busier one's.
+ */
+SyscallStats merge_all(const std::vector<SyscallStats> &statsArray) {
+    SyscallStats total;
+    for (const auto &stats : statsArray) {
+        merge_counts(total, stats);
+    }
+    if (timelineBucketNs != 0) pair_split_calls(total);
+    if (!statsArray.empty() && statsArray[0].shared) { // --aggregate=shared: the counts are already in one place
+        SyscallStats counts = statsArray[0].shared->snapshot();
+        merge_counts(total, counts);
+        total.byPid = std::move(counts.byPid);
+        return total;
+    }
+    if (!trackPids) return total;
+
+    WorkStealer<std::size_t> mergers(std::min<std::size_t>(statsArray.size(), kPidShards));
+    for (std::size_t shard = 0; shard < kPidShards; shard++) {
+        mergers.push(shard % mergers.workers(), shard);
+    }
+    mergers.run([&](std::size_t, std::size_t shard) {
+        for (const auto &stats : statsArray) {
+            merge_pid_shard(total.byPid, stats.byPid, shard);
+        }
+    });
+    return total;
+}
+
+
+/* counts_since returns the call counts 'now' has gained over 'before'. */
+SyscallStats counts_since(const SyscallStats &now, const SyscallStats &before) {
+    SyscallStats gained;
+    for (std::size_t id = 0; id < kSyscallCount; id++) {
+        gained.known[id].count = now.known[id].count - before.known[id].count;
+        gained.known[id].fails = now.known[id].fails - before.known[id].fails;
+    }
+    for (const auto &[name, s] : now.unknown) {
+        auto it = before.unknown.find(name);
+        Stats old = it == before.unknown.end() ? Stats{} : it->second;
+        if (s.count != old.count) gained.unknown.emplace(name, Stats{s.count - old.count, s.fails - old.fails});
+    }
+    return gained;
+}
+
+/*
+ * for_each_stat calls fn(name, stats) for every syscall that was seen, in
+ * alphabetical order. The known table is already in name order, so only the
+ * (few) unknown names are sorted and then merged into the walk over the array.
+ */
+template <typename Fn>
+void for_each_stat(const SyscallStats &stats, Fn fn) {
+    std::vector<const StatsMap::value_type *> unknown;
+    unknown.reserve(stats.unknown.size());
+    for (const auto &pair : stats.unknown) {
+        unknown.push_back(&pair);
+    }
+    std::sort(unknown.begin(), unknown.end(), [](auto *a, auto *b){ return a->first < b->first; });
+
+    std::size_t u = 0;
+    for (std::size_t id = 0; id < kSyscallCount; id++) {
+        while (u < unknown.size() && unknown[u]->first < kSortedSyscalls[id]) {
+            fn(std::string_view(unknown[u]->first), unknown[u]->second);
+            u++;
+        }
+        if (stats.known[id].count != 0) {
+            fn(kSortedSyscalls[id], stats.known[id]);
+        }
+    }
+    for (; u < unknown.size(); u++) {
+        fn(std::string_view(unknown[u]->first), unknown[u]->second);
+    }
+}
+
+
+/* find_stat returns the entry for 'name' in 'stats', or nullptr if it was never seen. */
+const Stats *find_stat(const SyscallStats &stats, std::string_view name) {
+    int id = syscall_id(name);
+    if (id != kUnknownSyscall) return &stats.known[id];
+    auto it = stats.unknown.find(name);
+    return it == stats.unknown.end() ? nullptr : &it->second;
+}
+
+
+/*
+ * OutputBuffer collects a whole report in one preallocated buffer, with
+ * numbers formatted by std::to_chars, and hands it to the kernel with a
+ * single write(2) in flush(). Per-pid and --follow reports can run to
+ * millions of rows, where a stream insertion per field adds up.
+ */
+class OutputBuffer {
+public:
+    explicit OutputBuffer(int fd = STDOUT_FILENO, std::size_t reserve = 1 << 20) : fd_(fd) {
+        buf_.reserve(reserve);
+    }
+    OutputBuffer(const OutputBuffer &) = delete;
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer &operator<<(std::string_view text) {
+        buf_.append(text);
+        return *this;
+    }
+
+    OutputBuffer &operator<<(char c) {
+        buf_.push_back(c);
+        return *this;
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, char> && !std::is_same_v<T, bool>>>
+    OutputBuffer &operator<<(T n) {
+        char digits[24];
+        char *end = std::to_chars(digits, digits + sizeof(digits), n).ptr;
+        buf_.append(digits, end - digits);
+        return *this;
+    }
+
+    /* flush writes out everything collected so far. Returns false if the write failed. */
+    bool flush() {
+        const char *p = buf_.data();
+        std::size_t left = buf_.size();
+        while (left > 0) {
+            ssize_t n = ::write(fd_, p, left);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            p += n;
+            left -= n;
+        }
+        buf_.clear();
+        return left == 0;
+    }
+
+private:
+    int fd_;
+    std::string buf_;
+};
+
+/* --format: how the call counts are written. */
+enum class OutputFormat { Text, Json, Csv, Prom };
+
+struct CountRow {
+    std::string_view syscall;
+    std::uint64_t count;
+    std::uint64_t fails;
+};
+
+/*
+ * CountSection is one block of counts: all calls, or those of one file or one
+ * pid. A Filter section instead has a row per active filter, with the option
+ * in 'syscall' and the lines it skipped in 'count'.
+ */
+struct CountSection {
+    enum Scope { Total, File, Pid, Filter } scope = Total;
+    std::string key; // File name or pid; empty for Total and Filter
+    std::vector<CountRow> rows;
+};
+
+/* count_section lists every syscall in 'stats' with its counts, in name order. */
+CountSection count_section(const SyscallStats &stats, CountSection::Scope scope = CountSection::Total, std::string key = "") {
+    CountSection section{scope, std::move(key), {}};
+    for_each_stat(stats, [&](std::string_view name, const Stats &s) {
+        section.rows.push_back(CountRow{name, s.count, s.fails});
+    });
+    return section;
+}
+
+/* delta_section lists only the syscalls whose counts changed between 'prev' and 'now', as increments. */
+CountSection delta_section(const SyscallStats &now, const SyscallStats &prev) {
+    CountSection section;
+    for_each_stat(now, [&](std::string_view name, const Stats &s) {
+        const Stats *old = find_stat(prev, name);
+        std::uint64_t oldCount = old ? old->count : 0;
+        std::uint64_t oldFails = old ? old->fails : 0;
+        if (s.count == oldCount) return;
+        section.rows.push_back(CountRow{name, s.count - oldCount, s.fails - oldFails});
+    });
+    return section;
+}
+
+/* pid_sections makes a section per process, in pid order. Lines without a pid prefix are under pid 0. */
+std::vector<CountSection> pid_sections(const PidStats &byPid) {
+    std::vector<std::pair<std::uint64_t, Stats>> entries;
+    for (const auto &shard : byPid.shards) {
+        entries.insert(entries.end(), shard.begin(), shard.end());
+    }
+    std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    std::vector<CountSection> sections;
+    std::uint64_t currentPid = UINT64_MAX;
+    for (const auto &[key, s] : entries) {
+        std::uint64_t pid = key >> 16;
+        std::size_t id = key & 0xffff;
+        if (pid != currentPid) {
+            sections.push_back(CountSection{CountSection::Pid, std::to_string(pid), {}});
+            currentPid = pid;
+        }
+        sections.back().rows.push_back(CountRow{id < kSyscallCount ? kSortedSyscalls[id] : std::string_view("(other)"),
+                                                s.count, s.fails});
+    }
+    return sections;
+}
+
+/* filter_section lists the lines each active filter in 'filter' dropped. */
+CountSection filter_section(const SyscallStats &stats, const LineFilter &filter) {
+    const bool active[kFilterStages] = {filter.byPid, filter.bySyscall, filter.failedOnly, filter.byErrno};
+    CountSection section{CountSection::Filter, "", {}};
+    for (std::size_t stage = 0; stage < kFilterStages; stage++) {
+        if (active[stage]) section.rows.push_back(CountRow{kFilterStageNames[stage], stats.skipped[stage], 0});
+    }
+    return section;
+}
+
+/* delta_pid_sections turns per-pid sections into increments since 'prev', keeping only what changed. */
+std::vector<CountSection> delta_pid_sections(const std::vector<CountSection> &now, const std::vector<CountSection> &prev) {
+    std::unordered_map<std::string_view, const CountSection *> before;
+    for (const CountSection &section : prev) before.emplace(section.key, &section);
+
+    std::vector<CountSection> sections;
+    for (const CountSection &section : now) {
+        std::unordered_map<std::string_view, const CountRow *> old;
+        if (auto it = before.find(section.key); it != before.end()) {
+            for (const CountRow &row : it->second->rows) old.emplace(row.syscall, &row);
+        }
+        CountSection delta{section.scope, section.key, {}};
+        for (const CountRow &row : section.rows) {
+            auto it = old.find(row.syscall);
+            std::uint64_t oldCount = it == old.end() ? 0 : it->second->count;
+            std::uint64_t oldFails = it == old.end() ? 0 : it->second->fails;
+            if (row.count != oldCount) delta.rows.push_back(CountRow{row.syscall, row.count - oldCount, row.fails - oldFails});
+        }
+        if (!delta.rows.empty()) sections.push_back(std::move(delta));
+    }
+    return sections;
+}
+
+/*
+ * ReportWriter writes CountSections in one --format into an OutputBuffer:
+ *
+ *   text  syscall: count=X, fails=Y, under "== file ==" / "== pid N ==" headings,
+ *         and "--syscall: skipped=N" under "== filters =="
+ *   json  {"syscalls":{"read":{"count":X,"fails":Y},..},"files":{..},"pids":{..},
+ *         "filters":{"--syscall":{"skipped":N}}}
+ *   csv   scope,key,syscall,count,fails (the header once per run); a filter
+ *         row is "filter,,--syscall,N,0"
+ *   prom  Prometheus text exposition: strace_syscalls_total{syscall="read"} X,
+ *         strace_syscall_failures_total, strace_file_* / strace_pid_*
+ *         families with a file or pid label, and
+ *         strace_filter_skipped_lines_total{filter="--syscall"} (one-shot
+ *         reports only)
+ *
+ * In --follow mode, and for --snapshots, each report is tagged with its
+ * 'label' ("update", "snapshot" or "final"), its number and the progress so
+ * far (bytes read, or milliseconds): a heading in text, extra fields in a
+ * JSON object per line, and the scope and key columns in CSV.
+ */
+class ReportWriter {
+public:
+    explicit ReportWriter(OutputFormat format) : format_(format) {}
+
+    OutputBuffer &out() { return out_; }
+
+    struct Label {
+        std::string_view name; // "update", "snapshot" or "final"; empty for a one-shot report
+        std::uint64_t number = 0;
+        std::uint64_t progress = 0; // How far the run had got, in 'unit'
+        bool delta = false; // Counts are increments since the previous update
+        std::string_view unit = "bytes";
+    };
+
+    void write(const std::vector<CountSection> &sections) { write(sections, Label{}); }
+
+    void write(const std::vector<CountSection> &sections, const Label &label) {
+        switch (format_) {
+        case OutputFormat::Text: write_text(sections, label); break;
+        case OutputFormat::Json: write_json(sections, label); break;
+        case OutputFormat::Csv: write_csv(sections, label); break;
+        case OutputFormat::Prom: write_prom(sections); break;
+        }
+    }
+
+    bool flush() { return out_.flush(); }
+
+private:
+    void write_text(const std::vector<CountSection> &sections, const Label &label) {
+        if (label.name == "final") out_ << "--- final (" << label.progress << ' ' << label.unit << ") ---\n";
+        else if (!label.name.empty()) out_ << "--- " << label.name << ' ' << label.number << " (" << label.progress << ' ' << label.unit << ") ---\n";
+        std::string_view sign = label.delta ? "+" : "";
+        for (const CountSection &section : sections) {
+            if (section.scope == CountSection::Filter) {
+                out_ << "\n== filters ==\n";
+                for (const CountRow &row : section.rows) out_ << row.syscall << ": skipped=" << row.count << '\n';
+                continue;
+            }
+            if (section.scope == CountSection::File) out_ << "\n== " << section.key << " ==\n";
+            if (section.scope == CountSection::Pid) out_ << "\n== pid " << section.key << " ==\n";
+            for (const CountRow &row : section.rows) {
+                out_ << row.syscall << ": count=" << sign << row.count << ", fails=" << sign << row.fails << '\n';
+            }
+        }
+    }
+
+    void json_string(std::string_view text) {
+        out_ << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out_ << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                out_ << std::string_view(escaped, 6);
+            } else {
+                out_ << c;
+            }
+        }
+        out_ << '"';
+    }
+
+    void json_rows(const CountSection &section) {
+        out_ << '{';
+        for (std::size_t i = 0; i < section.rows.size(); i++) {
+            if (i) out_ << ',';
+            json_string(section.rows[i].syscall);
+            out_ << ":{\"count\":" << section.rows[i].count << ",\"fails\":" << section.rows[i].fails << '}';
+        }
+        out_ << '}';
+    }
+
+    void write_json(const std::vector<CountSection> &sections, const Label &label) {
+        out_ << '{';
+        if (!label.name.empty()) {
+            json_string(label.name);
+            out_ << ':' << label.number << ",\"" << label.unit << "\":" << label.progress << ",\"delta\":" << (label.delta ? "true" : "false") << ',';
+        }
+        out_ << "\"syscalls\":";
+        bool total = false;
+        for (const CountSection &section : sections) {
+            if (section.scope != CountSection::Total) continue;
+            json_rows(section);
+            total = true;
+        }
+        if (!total) out_ << "{}";
+        for (auto [scope, name] : {std::pair{CountSection::File, "files"}, std::pair{CountSection::Pid, "pids"}}) {
+            bool first = true;
+            for (const CountSection &section : sections) {
+                if (section.scope != scope) continue;
+                out_ << (first ? ",\"" : ",") << (first ? std::string_view(name) : "") << (first ? "\":{" : "");
+                first = false;
+                json_string(section.key);
+                out_ << ':';
+                json_rows(section);
+            }
+            if (!first) out_ << '}';
+        }
+        for (const CountSection &section : sections) {
+            if (section.scope != CountSection::Filter) continue;
+            out_ << ",\"filters\":{";
+            for (std::size_t i = 0; i < section.rows.size(); i++) {
+                if (i) out_ << ',';
+                json_string(section.rows[i].syscall);
+                out_ << ":{\"skipped\":" << section.rows[i].count << '}';
+            }
+            out_ << '}';
+        }
+        out_ << "}\n";
+    }
+
+    void csv_field(std::string_view text) {
+        if (text.find_first_of(",\"\n\r") == std::string_view::npos) {
+            out_ << text;
+            return;
+        }
+        out_ << '"';
+        for (char c : text) {
+            if (c == '"') out_ << '"';
+            out_ << c;
+        }
+        out_ << '"';
+    }
+
+    void write_csv(const std::vector<CountSection> &sections, const Label &label) {
+        if (!csvHeader_) {
+            out_ << "scope,key,syscall,count,fails\n";
+            csvHeader_ = true;
+        }
+        static constexpr std::string_view kScopes[] = {"total", "file", "pid", "filter"};
+        for (const CountSection &section : sections) {
+            for (const CountRow &row : section.rows) {
+                if (!label.name.empty()) { // --follow: the report itself is the scope
+                    out_ << (label.delta ? std::string_view("delta") : label.name) << ',' << label.number;
+                } else {
+                    out_ << kScopes[section.scope] << ',';
+                    csv_field(section.key);
+                }
+                out_ << ',';
+                csv_field(row.syscall);
+                out_ << ',' << row.count << ',' << row.fails << '\n';
+            }
+        }
+    }
+
+    void prom_label(std::string_view text) {
+        out_ << '"';
+        for (char c : text) {
+            if (c == '\\' || c == '"') out_ << '\\' << c;
+            else if (c == '\n') out_ << "\\n";
+            else out_ << c;
+        }
+        out_ << '"';
+    }
+
+    void write_prom(const std::vector<CountSection> &sections) {
+        static constexpr std::string_view kPrefixes[] = {"strace_", "strace_file_", "strace_pid_"};
+        static constexpr std::string_view kLabels[] = {"", "file", "pid"};
+        for (auto scope : {CountSection::Total, CountSection::File, CountSection::Pid}) {
+            bool any = std::any_of(sections.begin(), sections.end(), [&](const CountSection &c) { return c.scope == scope; });
+            if (!any) continue;
+            for (bool fails : {false, true}) {
+                std::string_view metric = fails ? "syscall_failures_total" : "syscalls_total";
+                out_ << "# HELP " << kPrefixes[scope] << metric
+                     << (fails ? " Failed system calls in the trace.\n" : " System calls in the trace.\n")
+                     << "# TYPE " << kPrefixes[scope] << metric << " counter\n";
+                for (const CountSection &section : sections) {
+                    if (section.scope != scope) continue;
+                    for (const CountRow &row : section.rows) {
+                        out_ << kPrefixes[scope] << metric << '{';
+                        if (scope != CountSection::Total) {
+                            out_ << kLabels[scope] << '=';
+                            prom_label(section.key);
+                            out_ << ',';
+                        }
+                        out_ << "syscall=";
+                        prom_label(row.syscall);
+                        out_ << "} " << (fails ? row.fails : row.count) << '\n';
+                    }
+                }
+            }
+        }
+        for (const CountSection &section : sections) {
+            if (section.scope != CountSection::Filter) continue;
+            out_ << "# HELP strace_filter_skipped_lines_total Lines a filter option dropped.\n"
+                 << "# TYPE strace_filter_skipped_lines_total counter\n";
+            for (const CountRow &row : section.rows) {
+                out_ << "strace_filter_skipped_lines_total{filter=";
+                prom_label(row.syscall);
+                out_ << "} " << row.count << '\n';
+            }
+        }
+    }
+
+    OutputFormat format_;
+    OutputBuffer out_;
+    bool csvHeader_ = false;
+};
+
+
+/* find_latency returns the histogram for 'name', or nullptr if it was never timed. */
+const LatencyHistogram *find_latency(const SyscallStats &stats, std::string_view name) {
+    int id = syscall_id(name);
+    if (id != kUnknownSyscall) return stats.knownLatency[id].get();
+    auto it = stats.unknownLatency.find(name);
+    return it == stats.unknownLatency.end() ? nullptr : &it->second;
+}
+
+/* Formats nanoseconds as microseconds with three decimals. */
+std::string format_us(std::uint64_t ns) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%llu.%03llu", static_cast<unsigned long long>(ns / 1000),
+                  static_cast<unsigned long long>(ns % 1000));
+    return buf;
+}
+
+/* Formats nanoseconds as seconds with six decimals, like strace -T. */
+std::string format_seconds(std::uint64_t ns) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%llu.%06llu", static_cast<unsigned long long>(ns / 1000000000),
+                  static_cast<unsigned long long>(ns % 1000000000 / 1000));
+    return buf;
+}
+
+/*
+ * print_latency prints, for every syscall that had -T durations:
+ *
+ *   syscall: timed=N, total=T s, p50=.. p90=.. p99=.. p99.9=.. max=.. (us)
+ */
+void print_latency(OutputBuffer &out, const SyscallStats &stats) {
+    out << "\n== latency ==\n";
+    for_each_stat(stats, [&](std::string_view name, const Stats &) {
+        const LatencyHistogram *h = find_latency(stats, name);
+        if (h == nullptr || h->count() == 0) return;
+        out << name << ": timed=" << h->count()
+                  << ", total=" << format_seconds(h->total_ns()) << "s"
+                  << ", p50=" << format_us(h->quantile(500))
+                  << "us, p90=" << format_us(h->quantile(900))
+                  << "us, p99=" << format_us(h->quantile(990))
+                  << "us, p99.9=" << format_us(h->quantile(999))
+                  << "us, max=" << format_us(h->max_ns()) << "us\n";
+    });
+}
+
+
+/* find_errnos returns the errno counts for 'name', or nullptr if it never failed. */
+const ErrnoCounts *find_errnos(const SyscallStats &stats, std::string_view name) {
+    int id = syscall_id(name);
+    if (id != kUnknownSyscall) return stats.knownErrnos[id].get();
+    auto it = stats.unknownErrnos.find(name);
+    return it == stats.unknownErrnos.end() ? nullptr : &it->second;
+}
+
+/*
+ * print_errors prints, for every syscall that failed, how often each errno
+ * was returned, most frequent first:
+ *
+ *   syscall: fails=N (ENOENT=X, EACCES=Y)
+ *
+ * Failures without a recognised errno name are listed as "other".
+ */
+void print_errors(OutputBuffer &out, const SyscallStats &stats) {
+    out << "\n== errors ==\n";
+    for_each_stat(stats, [&](std::string_view name, const Stats &s) {
+        if (s.fails == 0) return;
+        out << name << ": fails=" << s.fails;
+        const ErrnoCounts *counts = find_errnos(stats, name);
+        if (counts != nullptr) {
+            std::vector<std::size_t> ids;
+            for (std::size_t e = 0; e <= kErrnoCount; e++) {
+                if ((*counts)[e] != 0) ids.push_back(e);
+            }
+            std::stable_sort(ids.begin(), ids.end(), [&](std::size_t a, std::size_t b) { return (*counts)[a] > (*counts)[b]; });
+            for (std::size_t k = 0; k < ids.size(); k++) {
+                out << (k ? ", " : " (")
+                          << (ids[k] < kErrnoCount ? kErrnoNames[ids[k]] : std::string_view("other"))
+                          << "=" << (*counts)[ids[k]];
+            }
+            if (!ids.empty()) out << ")";
+        }
+        out << "\n";
+    });
+}
+
+
+/*
+ * print_top_args prints the --top most frequent arguments of each syscall
+ * that has a sketch, paths quoted as strace printed them:
+ *
+ *   openat: calls=N
+ *     "/etc/ld.so.cache": count=C, fails=F
+ *
+ * A count that may include calls with other arguments (see TopK) is
+ * followed by ", error<=E".
+ */
+void print_top_args(OutputBuffer &out, const SyscallStats &stats) {
+    out << "\n== top arguments ==\n";
+    for_each_stat(stats, [&](std::string_view name, const Stats &s) {
+        int id = syscall_id(name);
+        if (id == kUnknownSyscall || !stats.topArgs[id]) return;
+        out << name << ": calls=" << s.count << "\n";
+        const char *quote = (kArgKinds[id] == kPathArg) ? "\"" : "";
+        for (const TopK::Entry *e : stats.topArgs[id]->top(topK)) {
+            out << "  " << quote << e->key << quote << ": count=" << e->count << ", fails=" << e->fails;
+            if (e->error != 0) out << ", error<=" << e->error;
+            out << "\n";
+        }
+    });
+}
+
+
+/*
+ * print_profile writes the --profile summary to 'out', as text or as one
+ * JSON object. 'workers' are the per-thread tables before merging.
+ */
+void print_profile(std::ostream &out, const std::vector<SyscallStats> &workers, bool json) {
+    const PipelineProfile &p = pipelineProfile;
+    auto ns = [](std::chrono::nanoseconds t) { return static_cast<std::uint64_t>(t.count()); };
+    auto mbPerSec = [](std::uint64_t bytes, std::chrono::nanoseconds t) {
+        double seconds = std::max(std::chrono::duration<double>(t).count(), 1e-9);
+        char rate[32];
+        std::snprintf(rate, sizeof(rate), "%.1f", bytes / (1024.0 * 1024.0) / seconds);
+        return std::string(rate);
+    };
+    bool reader = p.readerTime.count() != 0;
+
+    if (json) {
+        out << "{\"input\":{\"bytes\":" << p.inputBytes << ",\"run_s\":" << format_seconds(ns(p.runTime))
+            << ",\"mb_per_s\":" << mbPerSec(p.inputBytes, p.runTime) << "}";
+        if (reader) {
+            out << ",\"reader\":{\"bytes\":" << p.readerBytes << ",\"busy_s\":" << format_seconds(ns(p.readerTime))
+                << ",\"mb_per_s\":" << mbPerSec(p.readerBytes, p.readerTime) << "}";
+        }
+        if (p.queued) {
+            out << ",\"queue\":{\"producer_blocked_s\":" << format_seconds(ns(p.queue.producerBlocked))
+                << ",\"consumer_blocked_s\":" << format_seconds(ns(p.queue.consumerBlocked))
+                << ",\"high_water_items\":" << p.queue.highWaterItems
+                << ",\"high_water_bytes\":" << p.queue.highWaterBytes << "}";
+        }
+        out << ",\"workers\":[";
+        for (std::size_t i = 0; i < workers.size(); i++) {
+            out << (i ? "," : "") << "{\"lines\":" << workers[i].linesSeen
+                << ",\"parse_failures\":" << workers[i].parseFailures << "}";
+        }
+        out << "],\"merge_s\":" << format_seconds(ns(p.mergeTime))
+            << ",\"print_s\":" << format_seconds(ns(p.printTime)) << "}\n";
+        return;
+    }
+
+    out << "== profile ==\n"
+        << "input: " << p.inputBytes << " bytes, analysed in " << format_seconds(ns(p.runTime)) << "s ("
+        << mbPerSec(p.inputBytes, p.runTime) << " MB/s end to end, merge excluded)\n";
+    if (reader) {
+        out << "reader: " << p.readerBytes << " bytes in " << format_seconds(ns(p.readerTime)) << "s busy ("
+            << mbPerSec(p.readerBytes, p.readerTime) << " MB/s)\n";
+    }
+    if (p.queued) {
+        out << "queue: producer blocked=" << format_seconds(ns(p.queue.producerBlocked))
+            << "s, consumers blocked=" << format_seconds(ns(p.queue.consumerBlocked))
+            << "s, high-water=" << p.queue.highWaterItems << " items / " << p.queue.highWaterBytes << " bytes\n";
+    }
+    for (std::size_t i = 0; i < workers.size(); i++) {
+        out << "worker " << i << ": lines=" << workers[i].linesSeen
+            << ", parse failures=" << workers[i].parseFailures << "\n";
+    }
+    out << "merge: " << format_seconds(ns(p.mergeTime)) << "s\n"
+        << "print: " << format_seconds(ns(p.printTime)) << "s\n";
+}
+
+constexpr std::uint64_t kNsPerDay = 86400ull * 1000000000;
+
+/*
+ * unwrap_midnight joins the two days of a -t/-tt trace that ran past
+ * midnight (see TimeSeries::midnight_cut), so the calls after midnight follow
+ * on from those before it instead of coming first. A bucket width that does
+ * not divide a day cannot be shifted by a whole day, so those only get a warning.
+ */
+void unwrap_midnight(TimeSeries &series) {
+    std::uint64_t day = (kNsPerDay + timelineBucketNs - 1) / timelineBucketNs;
+    std::uint64_t cut = series.midnight_cut(day);
+    if (cut == 0) return;
+    if (kNsPerDay % timelineBucketNs == 0) {
+        series.shift_below(cut, day);
+    } else {
+        std::cerr << "Warning: the trace runs past midnight; a --timeline width that divides"
+                  << " 24h would join the two days up.\n";
+    }
+}
+
+/*
+ * print_timeline writes the --timeline series for plotting, either one row
+ * per bucket (CSV) or one array per column (JSON). Buckets run from the first
+ * to the last one any call fell in; buckets without calls are zeros, except
+ * that stretches of at least TimeSeries::kPageBuckets empty buckets are left
+ * out. JSON lists those as "gaps": [row, buckets] pairs, each saying that
+ * 'buckets' empty buckets come before row 'row'.
+ *
+ *   time_s,read,read_fails,openat,openat_fails,...
+ *   {"bucket_ns":N,"start_ns":T,"buckets":B,"gaps":[..],"series":{"read":{"count":[..],"fails":[..]},..}}
+ *
+ * Times are those strace printed: seconds since midnight for -t/-tt (past
+ * 24h for calls after midnight) and since the epoch for -ttt.
+ */
+void print_timeline(std::ostream &out, const TimeSeries &series, bool json) {
+    constexpr std::uint64_t kPage = TimeSeries::kPageBuckets;
+    std::vector<std::size_t> slots;
+    for (std::size_t slot = 0; slot <= kSyscallCount; slot++) {
+        if (!series.column(slot).pages.empty()) slots.push_back(slot);
+    }
+
+    // Runs of buckets to print: pages that follow each other are joined up
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> runs;
+    std::uint64_t prevKey = 0;
+    for (const auto &[key, span] : series.occupied()) {
+        if (!runs.empty() && key == prevKey + 1) runs.back().second = span.second;
+        else runs.push_back(span);
+        prevKey = key;
+    }
+
+    auto name = [](std::size_t slot) {
+        return slot < kSyscallCount ? kSortedSyscalls[slot] : std::string_view("(other)");
+    };
+    // Calls fn(bucket, pages) for every bucket printed, with pages[k] the page of slots[k] holding it
+    auto forEachBucket = [&](auto fn) {
+        std::vector<const TimeSeries::Page *> pages(slots.size());
+        for (const auto &[first, end] : runs) {
+            for (std::uint64_t b = first; b < end; b++) {
+                if (b == first || b % kPage == 0) {
+                    for (std::size_t k = 0; k < slots.size(); k++) pages[k] = series.find(slots[k], b / kPage);
+                }
+                fn(b, pages);
+            }
+        }
+    };
+    auto value = [](const TimeSeries::Page *page, std::uint64_t b, bool fails) -> std::uint32_t {
+        if (!page) return 0;
+        return fails ? page->fails[b % kPage] : page->counts[b % kPage];
+    };
+
+    if (json) {
+        std::uint64_t rows = 0;
+        out << "{\"bucket_ns\":" << timelineBucketNs << ",\"start_ns\":" << (runs.empty() ? 0 : runs[0].first) * timelineBucketNs;
+        for (std::size_t r = 0; r < runs.size(); r++) rows += runs[r].second - runs[r].first;
+        out << ",\"buckets\":" << rows << ",\"gaps\":[";
+        rows = 0;
+        for (std::size_t r = 0; r < runs.size(); r++) {
+            if (r > 0) out << (r > 1 ? "," : "") << "[" << rows << "," << runs[r].first - runs[r - 1].second << "]";
+            rows += runs[r].second - runs[r].first;
+        }
+        out << "],\"series\":{";
+        for (std::size_t k = 0; k < slots.size(); k++) {
+            out << (k ? "," : "") << "\"" << name(slots[k]) << "\":{";
+            for (bool fails : {false, true}) {
+                out << (fails ? "],\"fails\":[" : "\"count\":[");
+                bool firstValue = true;
+                forEachBucket([&](std::uint64_t b, const std::vector<const TimeSeries::Page *> &pages) {
+                    out << (firstValue ? "" : ",") << value(pages[k], b, fails);
+                    firstValue = false;
+                });
+            }
+            out << "]}";
+        }
+        out << "}}\n";
+        return;
+    }
+
+    out << "time_s";
+    for (std::size_t slot : slots) {
+        out << "," << name(slot) << "," << name(slot) << "_fails";
+    }
+    out << "\n";
+    forEachBucket([&](std::uint64_t b, const std::vector<const TimeSeries::Page *> &pages) {
+        out << format_seconds(b * timelineBucketNs);
+        for (std::size_t k = 0; k < slots.size(); k++) {
+            out << "," << value(pages[k], b, false) << "," << value(pages[k], b, true);
+        }
+        out << "\n";
+    });
+}
+
+
+/*
+ * Line scanning
+ *
+ * scan_lines finds, in a single pass over 64-byte blocks, every newline in a
+ * buffer together with the first '(' and the last '=' of each line, and writes
+ * them out as LineOffsets for parse_fields. The per-block character masks are
+ * built with AVX2, SSE2 or plain C++; which one is used is decided at run time
+ * from the CPU's features (see select_scanner).
+ */
+constexpr std::uint32_t kNoPos = UINT32_MAX;
+
+/* Offsets of one line, relative to the start of the scanned buffer. */
+struct LineOffsets {
+    std::uint32_t start;
+    std::uint32_t paren; // first '(' or kNoPos
+    std::uint32_t eq;    // last '=' or kNoPos
+    std::uint32_t end;   // the '\n', or the buffer end for an unterminated last line
+};
+
+/* Bit i of each mask is set when byte i of the block is that character. */
+struct BlockMasks {
+    std::uint64_t newline;
+    std::uint64_t paren;
+    std::uint64_t equals;
+};
+
+inline BlockMasks load_block_scalar(const char *p) {
+    BlockMasks m{0, 0, 0};
+    for (int i = 0; i < 64; i++) {
+        std::uint64_t bit = std::uint64_t(1) << i;
+        if (p[i] == '\n') m.newline |= bit;
+        else if (p[i] == '(') m.paren |= bit;
+        else if (p[i] == '=') m.equals |= bit;
+    }
+    return m;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+inline BlockMasks load_block_sse2(const char *p) {
+    const __m128i nl = _mm_set1_epi8('\n'), par = _mm_set1_epi8('('), eq = _mm_set1_epi8('=');
+    BlockMasks m{0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+        m.newline |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)))) << (16 * i);
+        m.paren |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, par)))) << (16 * i);
+        m.equals |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, eq)))) << (16 * i);
+    }
+    return m;
+}
+
+__attribute__((target("avx2"))) inline std::uint64_t match_mask_avx2(__m256i lo, __m256i hi, char c) {
+    __m256i needle = _mm256_set1_epi8(c);
+    std::uint64_t l = std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)));
+    std::uint64_t h = std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)));
+    return l | (h << 32);
+}
+
+__attribute__((target("avx2"))) inline BlockMasks load_block_avx2(const char *p) {
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+    return BlockMasks{match_mask_avx2(lo, hi, '\n'), match_mask_avx2(lo, hi, '('), match_mask_avx2(lo, hi, '=')};
+}
+#endif
+
+/*
+ * scan_lines_impl is the block walk shared by every variant. It stops after
+ * maxLines lines and returns how many bytes those lines covered, so the caller
+ * can resume from there. A final line without '\n' is only emitted when
+ * atEnd is set. size must fit in 32 bits.
+ */
+template <BlockMasks (*Load)(const char *)>
+__attribute__((always_inline)) inline std::size_t scan_lines_impl(const char *data, std::size_t size, bool atEnd,
+                                                                  LineOffsets *out, std::size_t maxLines, std::size_t &count) {
+    count = 0;
+    std::uint32_t start = 0, paren = kNoPos, eq = kNoPos;
+    std::size_t consumed = 0;
+
+    for (std::size_t base = 0; base < size; base += 64) {
+        BlockMasks m;
+        if (size - base >= 64) {
+            m = Load(data + base);
+        } else {
+            char tail[64] = {}; // Zero padding matches none of the characters we look for
+            std::memcpy(tail, data + base, size - base);
+            m = Load(tail);
+        }
+
+        std::uint64_t nl = m.newline, par = m.paren, eqs = m.equals;
+        while (nl != 0) {
+            int pos = __builtin_ctzll(nl);
+            std::uint64_t before = (std::uint64_t(1) << pos) - 1; // Bits belonging to the line ending here
+            if (paren == kNoPos && (par & before)) paren = base + __builtin_ctzll(par & before);
+            if (eqs & before) eq = base + 63 - __builtin_clzll(eqs & before);
+
+            out[count++] = LineOffsets{start, paren, eq, static_cast<std::uint32_t>(base + pos)};
+            consumed = base + pos + 1;
+            start = static_cast<std::uint32_t>(consumed);
+            paren = eq = kNoPos;
+            if (count == maxLines) return consumed;
+
+            std::uint64_t after = (pos == 63) ? 0 : ~std::uint64_t(0) << (pos + 1);
+            par &= after;
+            eqs &= after;
+            nl &= nl - 1;
+        }
+        if (paren == kNoPos && par) paren = base + __builtin_ctzll(par);
+        if (eqs) eq = base + 63 - __builtin_clzll(eqs);
+    }
+
+    if (atEnd && start < size) {
+        out[count++] = LineOffsets{start, paren, eq, static_cast<std::uint32_t>(size)};
+        consumed = size;
+    }
+    return consumed;
+}
+
+using ScanFn = std::size_t (*)(const char *, std::size_t, bool, LineOffsets *, std::size_t, std::size_t &);
+
+std::size_t scan_lines_scalar(const char *data, std::size_t size, bool atEnd,
+                              LineOffsets *out, std::size_t maxLines, std::size_t &count) {
+    return scan_lines_impl<load_block_scalar>(data, size, atEnd, out, maxLines, count);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+std::size_t scan_lines_sse2(const char *data, std::size_t size, bool atEnd,
+                            LineOffsets *out, std::size_t maxLines, std::size_t &count) {
+    return scan_lines_impl<load_block_sse2>(data, size, atEnd, out, maxLines, count);
+}
+
+__attribute__((target("avx2")))
+std::size_t scan_lines_avx2(const char *data, std::size_t size, bool atEnd,
+                            LineOffsets *out, std::size_t maxLines, std::size_t &count) {
+    return scan_lines_impl<load_block_avx2>(data, size, atEnd, out, maxLines, count);
+}
+#endif
+
+/*
+ * select_scanner picks the scan_lines variant for 'name' ("auto", "avx2",
+ * "sse2" or "scalar"). "auto" uses the best one this CPU supports; asking for
+ * an unsupported variant falls back to the next best. Returns nullptr for an
+ * unknown name.
+ */
+ScanFn select_scanner(const std::string &name, const char **chosen = nullptr) {
+    struct Variant { const char *name; ScanFn fn; bool supported; };
+    const Variant variants[] = {
+#if defined(__x86_64__) || defined(__i386__)
+        {"avx2", scan_lines_avx2, __builtin_cpu_supports("avx2") != 0},
+        {"sse2", scan_lines_sse2, __builtin_cpu_supports("sse2") != 0},
+#endif
+        {"scalar", scan_lines_scalar, true},
+    };
+    bool known = (name == "auto");
+    for (const auto &v : variants) {
+        known = known || name == v.name;
+        if (known && v.supported) {
+            if (chosen) *chosen = v.name;
+            return v.fn;
+        }
+    }
+    return known ? scan_lines_scalar : nullptr;
+}
+
+ScanFn scan_lines = select_scanner("auto");
+
+/* Largest buffer handed to scan_lines at once; keeps offsets in 32 bits. */
+constexpr std::size_t kScanWindow = 1 << 20;
+
+
+/*
+ * MappedFile maps a whole trace file read-only into memory so that worker
+ * threads can parse it in place, without a reader thread copying every line.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        if (data_ != nullptr) munmap(const_cast<char *>(data_), size_);
+    }
+
+    bool open(const char *path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+        size_ = ok ? static_cast<std::size_t>(st.st_size) : 0;
+        if (ok && size_ != 0) { // An empty trace is still valid, there is just nothing to map
+            void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = (p != MAP_FAILED);
+            if (ok) {
+                data_ = static_cast<const char *>(p);
+                madvise(p, size_, MADV_SEQUENTIAL); // Each worker streams through its own range
+            }
+        }
+        ::close(fd); // The mapping stays valid, and hundreds of inputs won't use up descriptors
+        return ok;
+    }
+
+    const char *data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+/*
+ * split_chunks divides [0, size) into at most n byte ranges whose boundaries
+ * fall just after a '\n', so that no line is split between two workers.
+ */
+std::vector<std::pair<std::size_t, std::size_t>> split_chunks(const char *data, std::size_t size, int n) {
+    std::vector<std::pair<std::size_t, std::size_t>> chunks;
+    std::size_t start = 0;
+    for (int i = 1; i <= n && start < size; i++) {
+        std::size_t end = (i == n) ? size : std::max(start, size / n * i);
+        if (end < size) {
+            const void *nl = std::memchr(data + end, '\n', size - end); // Move the boundary to the next line start
+            end = nl ? static_cast<const char *>(nl) - data + 1 : size;
+        }
+        chunks.emplace_back(start, end);
+        start = end;
+    }
+    return chunks;
+}
+
+/* The default for parse_range: the range is never split. */
+struct KeepRange {
+    std::size_t operator()(std::size_t, std::size_t end) const { return end; }
+};
+
+/*
+ * parse_range parses every line in data[begin, end) straight out of the
+ * mapping and accumulates the results into the given SyscallStats. After
+ * each scan window it calls split(begin, end), which may hand the rest of
+ * the range off elsewhere and return a new, newline-aligned end.
+ */
+template <typename Split = KeepRange>
+void parse_range(const char *data, std::size_t begin, std::size_t end, SyscallStats &stats, Split split = {}) {
+    std::array<LineOffsets, 1024> lines;
+    ParsedLine parsed;
+    PendingCalls pending;
+    while (begin < end) {
+        std::size_t window = std::min(end - begin, kScanWindow);
+        bool atEnd = (begin + window == end);
+        std::size_t count;
+        std::size_t used = scan_lines(data + begin, window, atEnd, lines.data(), lines.size(), count);
+
+        for (std::size_t k = 0; k < count; k++) {
+            const LineOffsets &l = lines[k];
+            std::string_view line(data + begin + l.start, l.end - l.start);
+            std::size_t paren = (l.paren == kNoPos) ? std::string_view::npos : l.paren - l.start;
+            std::size_t eq = (l.eq == kNoPos) ? std::string_view::npos : l.eq - l.start;
+            count_line(stats, parse_fields(line, paren, eq, parsed), parsed, pending);
+        }
+
+        if (used == 0) { // A single line longer than the window: fall back to a plain search
+            const void *nl = std::memchr(data + begin, '\n', end - begin);
+            std::size_t lineEnd = nl ? static_cast<const char *>(nl) - data : end;
+            count_line(stats, parse_line(std::string_view(data + begin, lineEnd - begin), parsed), parsed, pending);
+            used = lineEnd + 1 - begin;
+        }
+        begin += used;
+        if (begin < end) end = split(begin, end);
+    }
+    end_chunk(stats, pending);
+}
+
+/* Command line options. */
+struct Options {
+    std::string traceFile; // The first of traceFiles
+    std::vector<std::string> traceFiles; // Inputs, with directories expanded to the files in them
+    int numThreads = 0; // 0 = one per physical core
+    bool autoThreads = false; // "auto": the pipeline grows and shrinks its active workers (see ElasticPool),
+                              // up to numThreads if a count was given too, else one per CPU
+    bool useMmap = false; // --mmap: workers parse newline-aligned ranges of the mapped file
+    std::size_t batchSize = 256; // --batch-size: lines moved through the WorkQueue per lock
+    bool useRing = false; // --queue=ring: lock-free RingQueue instead of the mutex WorkQueue
+    std::size_t maxMemory = 64 << 20; // --max-memory: byte budget for queued lines, 0 = unbounded
+    std::size_t maxQueued = 0; // --max-queued: line budget for the queue, 0 = unbounded
+    bool queueReport = false; // --queue-report: print producer blocked time etc. to stderr
+    std::string simd = "auto"; // --simd: line scanner used by --mmap (auto|avx2|sse2|scalar)
+    bool follow = false; // --follow: keep analysing the file as it grows
+    double followInterval = 2.0; // --interval: seconds between --follow reports
+    bool followDeltas = false; // --deltas: --follow reports only what changed
+    bool perFile = false; // --per-file: also print a report for each input file
+    bool perPid = false; // --per-pid: also print a report for each process
+    bool pin = false; // --pin: bind each worker thread to its own core
+    bool latency = false; // --latency: also print -T duration percentiles per syscall
+    bool errors = false; // --errors: also print failures per syscall broken down by errno
+    std::uint64_t timeline = 0; // --timeline: bucket width in ns for a -t/-tt/-ttt time series, 0 = off
+    bool timelineJson = false; // --timeline-format=json instead of csv
+    std::string timelineOut; // --timeline-out: write the series here instead of stdout
+    bool cache = false; // --cache: read <trace>.sidx when it is up to date, else write it
+    std::vector<std::string> syscalls; // --syscall: only count these syscalls
+    std::vector<int> pids; // --pid: only count these processes
+    bool failedOnly = false; // --failed-only: only count calls that failed
+    std::vector<std::string> errnos; // --errno: only count calls that failed with these errnos
+    std::size_t top = 0; // --top: also print the K most frequent paths/fds per syscall, 0 = off
+    bool profile = false; // --profile: print pipeline counters to stderr (builds with PROFILE=1)
+    bool profileJson = false; // --profile=json
+    OutputFormat format = OutputFormat::Text; // --format
+    bool sharedStats = false; // --aggregate=shared: workers count into one SharedStats table
+    double snapshotInterval = 0; // --snapshots: seconds between reports while the workers run, 0 = off
+};
+
+void print_usage(const char *prog) {
+    std::cerr << "Usage: " << prog
+              << " [--mmap] [--batch-size N] [--queue=mutex|ring]"
+              << " [--max-memory SIZE[K|M|G]] [--max-queued N] [--queue-report]"
+              << " [--simd=auto|avx2|sse2|scalar]"
+              << " [--follow [--interval SECS] [--deltas]]"
+              << " [--per-file] [--per-pid] [--latency] [--errors] [--cache] [--pin]"
+              << " [--syscall LIST] [--pid LIST] [--failed-only] [--errno LIST] [--top K]"
+              << " [--timeline WIDTH[ns|us|ms|s|m|h] [--timeline-format=csv|json] [--timeline-out FILE]]"
+              << " [--profile[=json]] [--format=text|json|csv|prom]"
+              << " [--aggregate=per-thread|shared [--snapshots SECS]]"
+              << " [-j num_threads|auto]"
+              << " <trace_file|dir>... [num_threads|auto]\n";
+}
+
+/*
+ * parse_size reads a byte count with an optional K, M or G suffix.
+ *
+ * Returns false if 'text' is not a valid size.
+ */
+bool parse_size(const std::string &text, std::size_t &out) {
+    std::size_t n = 0;
+    auto [end, err] = std::from_chars(text.data(), text.data() + text.size(), n);
+    if (err != std::errc()) return false;
+    std::string_view suffix(end, text.data() + text.size() - end);
+    int shift = 0;
+    if (suffix == "K" || suffix == "k") shift = 10;
+    else if (suffix == "M" || suffix == "m") shift = 20;
+    else if (suffix == "G" || suffix == "g") shift = 30;
+    else if (!suffix.empty()) return false;
+    if (n > (SIZE_MAX >> shift)) return false; // The shift would overflow
+    out = n << shift;
+    return true;
+}
+
+/*
+ * parse_number reads a whole decimal integer no smaller than 'min'.
+ *
+ * Returns false, leaving 'out' unchanged, if 'text' has anything else in it.
+ */
+template <typename T>
+bool parse_number(std::string_view text, T &out, T min = 1) {
+    T value{};
+    auto [end, err] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (err != std::errc() || end != text.data() + text.size() || value < min) return false;
+    out = value;
+    return true;
+}
+
+/* parse_seconds_option reads a finite number of seconds greater than zero, e.g. "0.5". */
+bool parse_seconds_option(const char *text, double &out) {
+    char *end = nullptr;
+    double value = std::strtod(text, &end);
+    if (end == text || *end != '\0' || !std::isfinite(value) || value <= 0) return false;
+    out = value;
+    return true;
+}
+
+/* takes_value says whether a command-line option consumes the argument after it. */
+bool takes_value(std::string_view arg) {
+    static constexpr std::string_view kValueOptions[] = {
+        "--batch-size", "--max-memory", "--max-queued", "--interval", "--timeline", "--timeline-out",
+        "--syscall", "--pid", "--top", "--errno", "--snapshots", "-j", "--threads"};
+    return std::find(std::begin(kValueOptions), std::end(kValueOptions), arg) != std::end(kValueOptions);
+}
+
+/* split_list splits a comma-separated option value, dropping empty items. */
+std::vector<std::string> split_list(const std::string &text) {
+    std::vector<std::string> items;
+    std::size_t start = 0;
+    while (start <= text.size()) {
+        std::size_t comma = std::min(text.find(',', start), text.size());
+        if (comma > start) items.push_back(text.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+/*
+ * parse_width reads a time span such as "250ns", "500us", "1.5ms", "1s",
+ * "1m" or "1h" as nanoseconds; a bare number is seconds.
+ *
+ * Returns false if 'text' is not a valid, non-zero span, or one too long
+ * to hold in nanoseconds.
+ */
+bool parse_width(const std::string &text, std::uint64_t &ns) {
+    std::size_t unit = text.find_first_not_of("0123456789.");
+    if (unit == 0) return false;
+    std::string number = text.substr(0, unit);
+    std::string suffix = (unit == std::string::npos) ? "" : text.substr(unit);
+    std::uint64_t unitNs;
+    if (suffix.empty() || suffix == "s") unitNs = 1000000000;
+    else if (suffix == "ms") unitNs = 1000000;
+    else if (suffix == "us") unitNs = 1000;
+    else if (suffix == "ns") unitNs = 1;
+    else if (suffix == "m") unitNs = 60ULL * 1000000000;
+    else if (suffix == "h") unitNs = 3600ULL * 1000000000;
+    else return false;
+
+    std::uint64_t whole = 0;
+    const char *end = number.data() + number.size();
+    auto [p, ec] = std::from_chars(number.data(), end, whole);
+    if (ec != std::errc() || whole >= UINT64_MAX / unitNs) return false; // Leaves room for the fraction too
+    ns = whole * unitNs;
+    if (p < end && *p == '.') {
+        for (std::uint64_t scale = unitNs; ++p < end && *p >= '0' && *p <= '9'; ) { // Digits past nanoseconds are ignored
+            scale /= 10;
+            ns += (*p - '0') * scale;
+        }
+    }
+    return p == end && ns != 0;
+}
+
+/* make_filter builds the LineFilter for the filter options in 'opts'. */
+LineFilter make_filter(const Options &opts) {
+    LineFilter filter;
+    filter.byPid = !opts.pids.empty();
+    filter.pids = opts.pids;
+    std::sort(filter.pids.begin(), filter.pids.end());
+    filter.bySyscall = !opts.syscalls.empty();
+    for (const auto &name : opts.syscalls) {
+        filter.firstBytes[static_cast<unsigned char>(name[0])] = true;
+        int id = syscall_id(name);
+        if (id != kUnknownSyscall) filter.syscalls[id] = true;
+        else filter.otherSyscalls.push_back(name);
+    }
+    filter.failedOnly = opts.failedOnly;
+    filter.byErrno = !opts.errnos.empty();
+    for (const auto &name : opts.errnos) {
+        filter.errnos[errno_id(name)] = true;
+    }
+    return filter;
+}
+
+/*
+ * parse_options fills 'opts' from the command line. Flags may appear anywhere;
+ * the remaining arguments are <trace_file> and the optional [num_threads].
+ *
+ * Returns false if the command line is unusable.
+ */
+bool parse_options(int argc, char *argv[], Options &opts) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (takes_value(arg) && i + 1 == argc) {
+            std::cerr << "Error: " << arg << " needs a value\n";
+            return false;
+        }
+        if (arg == "--mmap") {
+            opts.useMmap = true;
+        } else if (arg == "--batch-size") {
+            if (!parse_number(argv[++i], opts.batchSize)) {
+                std::cerr << "Error: invalid batch-size: " << argv[i] << "\n";
+                return false;
+            }
+        } else if (arg == "--max-memory") {
+            if (!parse_size(argv[++i], opts.maxMemory)) {
+                std::cerr << "Error: invalid max-memory: " << argv[i] << "\n";
+                return false;
+            }
+        } else if (arg == "--max-queued") {
+            if (!parse_size(argv[++i], opts.maxQueued)) {
+                std::cerr << "Error: invalid max-queued: " << argv[i] << "\n";
+                return false;
+            }
+        } else if (arg == "--queue-report") {
+            opts.queueReport = true;
+        } else if (arg == "--follow") {
+            opts.follow = true;
+        } else if (arg == "--deltas") {
+            opts.followDeltas = true;
+        } else if (arg == "--interval") {
+            if (!parse_seconds_option(argv[++i], opts.followInterval)) {
+                std::cerr << "Error: invalid interval: " << argv[i] << "\n";
+                return false;
+            }
+        } else if (arg.compare(0, 7, "--simd=") == 0) {
+            opts.simd = arg.substr(7);
+            if (!select_scanner(opts.simd)) {
+                std::cerr << "Error: unknown simd variant: " << opts.simd << "\n";
+                return false;
+            }
+        } else if (arg == "--timeline") {
+            if (!parse_width(argv[++i], opts.timeline)) {
+                std::cerr << "Error: invalid timeline bucket width: " << argv[i] << "\n";
+                return false;
+            }
+        } else if (arg == "--timeline-format=csv" || arg == "--timeline-format=json") {
+            opts.timelineJson = (arg == "--timeline-format=json");
+        } else if (arg == "--timeline-out") {
+            opts.timelineOut = argv[++i];
+        } else if (arg == "--latency") {
+            opts.latency = true;
+        } else if (arg == "--errors") {
+            opts.errors = true;
+        } else if (arg == "--cache") {
+            opts.cache = true;
+        } else if (arg == "--syscall") {
+            auto names = split_list(argv[++i]);
+            opts.syscalls.insert(opts.syscalls.end(), names.begin(), names.end());
+        } else if (arg == "--pid") {
+            for (const auto &item : split_list(argv[++i])) {
+                int pid = 0;
+                if (!parse_number(item, pid, 0)) { // 0 is the lines without a pid prefix
+                    std::cerr << "Error: invalid pid: " << item << "\n";
+                    return false;
+                }
+                opts.pids.push_back(pid);
+            }
+        } else if (arg == "--failed-only") {
+            opts.failedOnly = true;
+        } else if (arg == "--top") {
+            if (!parse_number(argv[++i], opts.top)) {
+                std::cerr << "Error: invalid top count: " << argv[i] << "\n";
+                return false;
+            }
+        } else if (arg == "--errno") {
+            for (const auto &name : split_list(argv[++i])) {
+                if (errno_id(name) == kOtherErrno) {
+                    std::cerr << "Error: unknown errno: " << name << "\n";
+                    return false;
+                }
+                opts.errnos.push_back(name);
+            }
+        } else if (arg == "--per-pid") {
+            opts.perPid = true;
+        } else if (arg == "--pin") {
+            opts.pin = true;
+        } else if (arg == "--aggregate=per-thread" || arg == "--aggregate=shared") {
+            opts.sharedStats = (arg == "--aggregate=shared");
+        } else if (arg == "--snapshots") {
+            if (!parse_seconds_option(argv[++i], opts.snapshotInterval)) {
+                std::cerr << "Error: invalid snapshot interval: " << argv[i] << "\n";
+                return false;
+            }
+        } else if (arg.compare(0, 9, "--format=") == 0) {
+            std::string name = arg.substr(9);
+            if (name == "text") opts.format = OutputFormat::Text;
+            else if (name == "json") opts.format = OutputFormat::Json;
+            else if (name == "csv") opts.format = OutputFormat::Csv;
+            else if (name == "prom") opts.format = OutputFormat::Prom;
+            else {
+                std::cerr << "Error: unknown format: " << name << "\n";
+                return false;
+            }
+        } else if (arg == "--profile" || arg == "--profile=json") {
+            if (!kProfile) {
+                std::cerr << "Error: --profile needs a build with the counters compiled in (make PROFILE=1)\n";
+                return false;
+            }
+            opts.profile = true;
+            opts.profileJson = (arg == "--profile=json");
+        } else if (arg == "--per-file") {
+            opts.perFile = true;
+        } else if ((arg == "-j" || arg == "--threads") && std::string(argv[i + 1]) == "auto") {
+            opts.autoThreads = true;
+            i++;
+        } else if (arg == "-j" || arg == "--threads") {
+            if (!parse_number(argv[++i], opts.numThreads)) {
+                std::cerr << "Warning: invalid num_threads. Using 1.\n";
+                opts.numThreads = 1;
+            }
+        } else if (arg == "--queue=mutex" || arg == "--queue=ring") {
+            opts.useRing = (arg == "--queue=ring");
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Error: unknown option: " << arg << "\n";
+            return false;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.empty()) return false;
+    if (opts.snapshotInterval != 0 && (!opts.sharedStats || opts.follow)) {
+        std::cerr << "Error: --snapshots needs --aggregate=shared, and --follow has its own reports\n";
+        return false;
+    }
+    if (opts.format != OutputFormat::Text) {
+        // Only the call counts (total, --per-file, --per-pid) have a machine-readable form
+        if (opts.latency || opts.errors || opts.top != 0 || (opts.timeline != 0 && opts.timelineOut.empty())) {
+            std::cerr << "Error: --latency, --errors, --top and --timeline without --timeline-out"
+                      << " only have a text format\n";
+            return false;
+        }
+        if (opts.format == OutputFormat::Prom && (opts.follow || opts.snapshotInterval != 0)) {
+            // Each report is a whole exposition; appended to the last one they would repeat every metric family
+            std::cerr << "Error: --format=prom writes a single report, not the series --follow and --snapshots write\n";
+            return false;
+        }
+    }
+
+    // A trailing [num_threads] is all digits, or "auto"; name a file called "4" as ./4
+    std::error_code ec;
+    if (positional.size() >= 2) {
+        const std::string &last = positional.back();
+        bool digits = std::all_of(last.begin(), last.end(), [](unsigned char c) { return std::isdigit(c); });
+        if (last == "auto") {
+            opts.autoThreads = true;
+            positional.pop_back();
+        } else if (digits) {
+            if (!parse_number(last, opts.numThreads)) {
+                std::cerr << "Warning: invalid num_threads. Using 1.\n";
+                opts.numThreads = 1;
+            }
+            positional.pop_back();
+        }
+    }
+
+    for (const auto &path : positional) {
+        if (std::filesystem::is_directory(path, ec)) {
+            std::vector<std::string> entries; // e.g. the trace.<pid> files from strace -ff
+            for (const auto &entry : std::filesystem::directory_iterator(path, ec)) {
+                if (entry.is_regular_file(ec)) entries.push_back(entry.path().string());
+            }
+            std::sort(entries.begin(), entries.end());
+            opts.traceFiles.insert(opts.traceFiles.end(), entries.begin(), entries.end());
+        } else if (std::filesystem::exists(path, ec) || opts.follow) { // --follow reports a missing file itself
+            opts.traceFiles.push_back(path);
+        } else {
+            std::cerr << "Error: no such trace file: " << path << "\n";
+            return false;
+        }
+    }
+    if (opts.traceFiles.empty()) {
+        std::cerr << "Error: no trace files found\n";
+        return false;
+    }
+    // An input named twice (or by a file and its directory) would be counted twice under one --per-file key
+    std::vector<std::pair<std::filesystem::path, const std::string *>> inputs;
+    for (const auto &path : opts.traceFiles) {
+        std::filesystem::path id = std::filesystem::weakly_canonical(path, ec);
+        inputs.emplace_back(ec ? std::filesystem::path(path) : id, &path);
+    }
+    std::sort(inputs.begin(), inputs.end());
+    auto twice = std::adjacent_find(inputs.begin(), inputs.end(), [](const auto &a, const auto &b) { return a.first == b.first; });
+    if (twice != inputs.end()) {
+        std::cerr << "Error: trace file given more than once: " << *twice->second << "\n";
+        return false;
+    }
+    opts.traceFile = opts.traceFiles[0];
+    return true;
+}
+
+/*
+ * CPU topology
+ *
+ * With --pin, worker i runs on pinOrder[i]: first one hardware thread of
+ * every physical core, node by node, then the cores' remaining SMT siblings,
+ * so workers fill whole cores before sharing one and neighbouring workers
+ * share a node. The topology comes from /sys/devices/system/cpu and only
+ * covers the CPUs this process is allowed to run on.
+ */
+struct CpuInfo {
+    int cpu;
+    int core = 0;    // topology/core_id
+    int package = 0; // topology/physical_package_id
+    int node = 0;    // From the cpuN/nodeK link
+};
+
+/* parse_cpu_list reads a sysfs CPU list such as "0-3,8,10-11". */
+std::vector<int> parse_cpu_list(const std::string &text) {
+    std::vector<int> cpus;
+    for (const auto &item : split_list(text)) {
+        int first = 0, last = 0;
+        const char *end = item.data() + item.size();
+        auto [p, ec] = std::from_chars(item.data(), end, first);
+        if (ec != std::errc()) continue;
+        last = first;
+        if (p < end && *p == '-' && std::from_chars(p + 1, end, last).ec != std::errc()) continue;
+        for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+bool read_sysfs_int(const std::string &path, int &value) {
+    std::ifstream in(path);
+    return static_cast<bool>(in >> value);
+}
+
+/* discover_topology lists the CPUs this process may use; empty if it cannot tell. */
+std::vector<CpuInfo> discover_topology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool haveMask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    std::ifstream onlineFile("/sys/devices/system/cpu/online");
+    std::string online;
+    std::getline(onlineFile, online);
+    std::vector<int> candidates = parse_cpu_list(online);
+    if (candidates.empty() && haveMask) { // No sysfs (e.g. a restricted container): the mask is all we know
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) candidates.push_back(cpu);
+    }
+
+    std::vector<CpuInfo> cpus;
+    for (int cpu : candidates) {
+        if (haveMask && (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))) continue;
+        CpuInfo info{cpu};
+        std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        if (!read_sysfs_int(dir + "/topology/core_id", info.core)) info.core = cpu;
+        read_sysfs_int(dir + "/topology/physical_package_id", info.package);
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+            std::string name = entry.path().filename().string();
+            if (name.starts_with("node")) std::from_chars(name.data() + 4, name.data() + name.size(), info.node);
+        }
+        cpus.push_back(info);
+    }
+    return cpus;
+}
+
+/* physical_cores counts the distinct cores in 'cpus', so SMT siblings count once. */
+std::size_t physical_cores(const std::vector<CpuInfo> &cpus) {
+    std::vector<std::pair<int, int>> cores;
+    for (const CpuInfo &c : cpus) cores.emplace_back(c.package, c.core);
+    std::sort(cores.begin(), cores.end());
+    return std::unique(cores.begin(), cores.end()) - cores.begin();
+}
+
+/* placement_order sorts 'cpus' into the order workers are pinned in. */
+std::vector<CpuInfo> placement_order(std::vector<CpuInfo> cpus) {
+    std::sort(cpus.begin(), cpus.end(), [](const CpuInfo &a, const CpuInfo &b) {
+        return std::tie(a.node, a.package, a.core, a.cpu) < std::tie(b.node, b.package, b.core, b.cpu);
+    });
+    std::vector<std::pair<int, CpuInfo>> ranked; // Which of its core's hardware threads each CPU is
+    for (std::size_t i = 0; i < cpus.size(); i++) {
+        bool sibling = i > 0 && cpus[i].package == cpus[i - 1].package && cpus[i].core == cpus[i - 1].core;
+        ranked.emplace_back(sibling ? ranked.back().first + 1 : 0, cpus[i]);
+    }
+    std::stable_sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    for (std::size_t i = 0; i < ranked.size(); i++) cpus[i] = ranked[i].second;
+    return cpus;
+}
+
+/* Set from --pin; empty when the OS places the threads. */
+std::vector<CpuInfo> pinOrder;
+cpu_set_t unpinnedMask; // The affinity the process started with
+
+#ifdef HAVE_NUMA
+/* move_to_node migrates the whole pages inside [p, p + size) to 'node'; pages shared with neighbours stay. */
+void move_to_node(const void *p, std::size_t size, int node) {
+    std::uintptr_t page = sysconf(_SC_PAGESIZE);
+    std::uintptr_t first = (reinterpret_cast<std::uintptr_t>(p) + page - 1) & ~(page - 1);
+    std::uintptr_t last = (reinterpret_cast<std::uintptr_t>(p) + size) & ~(page - 1);
+    std::vector<void *> pages;
+    for (std::uintptr_t a = first; a < last; a += page) pages.push_back(reinterpret_cast<void *>(a));
+    if (pages.empty()) return;
+    std::vector<int> nodes(pages.size(), node), status(pages.size());
+    numa_move_pages(0, pages.size(), pages.data(), nodes.data(), status.data(), MPOL_MF_MOVE);
+}
+#endif
+
+/*
+ * pin_worker binds the calling thread to worker i's CPU. With libnuma it
+ * also moves the fixed-size part of the worker's stats table to that CPU's
+ * node: tables are constructed by the main thread, so their pages start on
+ * its node, while anything the worker allocates itself is placed locally by
+ * first touch.
+ */
+void pin_worker(std::size_t i, SyscallStats *stats = nullptr) {
+    if (pinOrder.empty()) return;
+    const CpuInfo &c = pinOrder[i % pinOrder.size()];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(c.cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#ifdef HAVE_NUMA
+    if (stats != nullptr && numa_available() >= 0) move_to_node(stats, sizeof(*stats), c.node);
+#else
+    (void)stats;
+#endif
+}
+
+/* unpin lets the calling thread run anywhere again, e.g. the main thread after it has worked as worker 0. */
+void unpin() {
+    if (!pinOrder.empty()) sched_setaffinity(0, sizeof(unpinnedMask), &unpinnedMask);
+}
+
+/*
+ * parse_parallel parses data[0, size) with up to statsArray.size() threads,
+ * each taking one newline-aligned range and adding to its own stats table.
+ * Small buffers are not worth a thread each, so they get fewer ranges.
+ */
+void parse_parallel(const char *data, std::size_t size, std::vector<SyscallStats> &statsArray) {
+    std::size_t ranges = std::min(statsArray.size(), size / kScanWindow + 1);
+    auto chunks = split_chunks(data, size, static_cast<int>(ranges));
+    if (chunks.size() <= 1) {
+        if (!chunks.empty()) parse_range(data, chunks[0].first, chunks[0].second, statsArray[0]);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(chunks.size());
+    for (std::size_t i = 0; i < chunks.size(); i++) {
+        threads.emplace_back([data, &chunks, &statsArray, i](){
+            pin_worker(i, &statsArray[i]);
+            parse_range(data, chunks[i].first, chunks[i].second, statsArray[i]);
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+/* A newline-aligned byte range of one input file: the unit of work for run_mmap. */
+struct ChunkTask {
+    std::size_t file;
+    std::size_t begin;
+    std::size_t end;
+};
+
+/* Chunks are sized so each worker gets several, within these bounds. */
+constexpr std::size_t kMinChunk = 1 << 20;
+constexpr std::size_t kMaxChunk = 64 << 20;
+
+/*
+ * run_mmap maps every input file and cuts them into newline-aligned chunks.
+ * Small files are one chunk each; large ones are split so that no single file
+ * holds up the pool. There is no producer thread: each worker starts with an
+ * equal share of the bytes as a run of consecutive chunks in its own
+ * WorkStealer deque, parses them in file order straight into its own stats
+ * table, and then steals from the far end of busier workers' runs. While
+ * another worker is idle, a chunk being parsed gives away the second half of
+ * what it has left, so one slow stretch of a trace does not hold up the
+ * rest. A worker only splits once its own run is used up: until then the
+ * idle worker can steal a whole chunk of it. With --per-file each chunk is
+ * also added to its file's table in 'perFile'.
+ */
+bool run_mmap(const Options &opts, std::vector<SyscallStats> &statsArray, std::vector<SyscallStats> &perFile) {
+    std::size_t numFiles = opts.traceFiles.size();
+    std::vector<MappedFile> files(numFiles);
+    std::size_t totalBytes = 0;
+    for (std::size_t f = 0; f < numFiles; f++) {
+        if (!files[f].open(opts.traceFiles[f].c_str())) {
+            std::cerr << "Error: cannot open input file: "
+                      << opts.traceFiles[f] << "\n";
+            return false;
+        }
+        totalBytes += files[f].size();
+    }
+
+    std::size_t chunkSize = std::clamp(totalBytes / (statsArray.size() * 4), kMinChunk, kMaxChunk);
+    std::vector<ChunkTask> tasks;
+    for (std::size_t f = 0; f < numFiles; f++) {
+        std::size_t pieces = (files[f].size() + chunkSize - 1) / chunkSize;
+        for (const auto &c : split_chunks(files[f].data(), files[f].size(), static_cast<int>(std::max<std::size_t>(pieces, 1)))) {
+            tasks.push_back(ChunkTask{f, c.first, c.second});
+        }
+    }
+
+    if (opts.perFile) perFile = std::vector<SyscallStats>(numFiles);
+    std::vector<std::mutex> fileLocks(opts.perFile ? numFiles : 0);
+    std::vector<std::unique_ptr<SyscallStats>> scratch(statsArray.size()); // Per-chunk tables, only needed for --per-file
+
+    WorkStealer<ChunkTask> scheduler(std::min(statsArray.size(), std::max<std::size_t>(tasks.size(), 1)));
+    std::size_t dealt = 0;
+    for (const ChunkTask &task : tasks) {
+        scheduler.push(dealt * scheduler.workers() / std::max<std::size_t>(totalBytes, 1), task);
+        dealt += task.end - task.begin;
+    }
+    std::atomic<std::size_t> splits{0};
+
+    scheduler.run([&](std::size_t w, const ChunkTask &task) {
+        const char *data = files[task.file].data();
+        auto split = [&](std::size_t begin, std::size_t end) {
+            // Only split once this worker's own queue is empty: until then a thief takes one of its waiting chunks
+            if (end - begin < 2 * kMinChunk || !scheduler.hungry() || scheduler.has_queued(w)) return end;
+            const void *nl = std::memchr(data + begin + (end - begin) / 2, '\n', (end - begin) / 2);
+            if (nl == nullptr) return end;
+            std::size_t mid = static_cast<const char *>(nl) - data + 1;
+            scheduler.push(w, ChunkTask{task.file, mid, end});
+            splits.fetch_add(1, std::memory_order_relaxed);
+            return mid;
+        };
+        if (!opts.perFile) {
+            parse_range(data, task.begin, task.end, statsArray[w], split);
+            return;
+        }
+        if (!scratch[w]) scratch[w] = std::make_unique<SyscallStats>();
+        *scratch[w] = SyscallStats{};
+        parse_range(data, task.begin, task.end, *scratch[w], split);
+        merge_stats(statsArray[w], *scratch[w]);
+        std::lock_guard<std::mutex> lock(fileLocks[task.file]);
+        merge_stats(perFile[task.file], *scratch[w]);
+    }, [&](std::size_t w) { pin_worker(w, &statsArray[w]); });
+    unpin(); // This thread was worker 0
+
+    if (opts.queueReport) {
+        std::cerr << "scheduler: workers=" << scheduler.workers() << ", chunks=" << tasks.size()
+                  << ", steals=" << scheduler.steals() << ", splits=" << splits.load() << "\n";
+    }
+    return true;
+}
+
+/*
+ * Compressed input
+ *
+ * .gz and .zst traces are decoded by a stage of decoder threads that hand
+ * blocks of text (Segments) to the parse workers through a WorkQueue, so
+ * reading, decompression and parsing overlap and the queue's byte budget
+ * bounds how much decoded text is held. A file that can be cut up without
+ * decompressing it first (BGZF gzip, multi-frame zstd) is split into
+ * independent tasks that all decoders share; otherwise one decoder streams
+ * it. Segments do not end on line boundaries, so workers parse the whole
+ * lines inside a segment and keep its partial first and last lines
+ * (SegmentEdges), which are joined in file order once decoding is done.
+ */
+enum class Codec { Plain, Gzip, Zstd };
+
+/* detect_codec tells the format of a file from its first bytes. */
+Codec detect_codec(const char *data, std::size_t size) {
+    auto *p = reinterpret_cast<const unsigned char *>(data);
+    if (size >= 2 && p[0] == 0x1f && p[1] == 0x8b) return Codec::Gzip;
+    if (size >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd) return Codec::Zstd;
+    return Codec::Plain;
+}
+
+/* is_compressed reads just enough of 'path' to tell whether it is .gz or .zst data. */
+bool is_compressed(const std::string &path) {
+    char magic[4] = {};
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    ssize_t n = read(fd, magic, sizeof(magic));
+    ::close(fd);
+    return n > 0 && detect_codec(magic, n) != Codec::Plain;
+}
+
+/* A block of decoded text. (task, part) orders segments as in the file. */
+struct Segment {
+    std::size_t task = 0;
+    std::size_t part = 0;
+    std::string text;
+};
+
+inline std::size_t queued_bytes(const Segment &segment) {
+    return segment.text.capacity() + sizeof(Segment);
+}
+
+/* Decoded text per Segment. */
+constexpr std::size_t kSegmentSize = 4 << 20;
+
+/* Tasks are cut from whole BGZF members or zstd frames once they reach this much input. */
+constexpr std::size_t kMinDecodeTask = 1 << 20;
+
+/*
+ * SegmentWriter collects one task's decoded output into Segments of
+ * kSegmentSize and pushes each to the parse workers as it fills up.
+ */
+class SegmentWriter {
+public:
+    SegmentWriter(WorkQueue<Segment> &queue, std::size_t task) : queue_(queue), task_(task) {}
+
+    /* Free space at the end of the current segment; a full one is sent first. */
+    std::pair<char *, std::size_t> space() {
+        if (used_ == segment_.text.size()) {
+            flush();
+            segment_.task = task_;
+            segment_.part = part_++;
+            segment_.text.resize(kSegmentSize);
+        }
+        return {segment_.text.data() + used_, segment_.text.size() - used_};
+    }
+
+    void commit(std::size_t n) { used_ += n; }
+
+    void flush() {
+        if (used_ == 0) return;
+        segment_.text.resize(used_);
+        queue_.push(std::move(segment_));
+        segment_ = Segment{};
+        used_ = 0;
+    }
+
+private:
+    WorkQueue<Segment> &queue_;
+    std::size_t task_;
+    std::size_t part_ = 0;
+    std::size_t used_ = 0;
+    Segment segment_;
+};
+
+#ifdef HAVE_ZLIB
+/*
+ * inflate_range decodes one or more gzip members. zlib counts input in
+ * 32 bits, so large ranges are fed in slices.
+ */
+bool inflate_range(const char *data, std::size_t size, SegmentWriter &out, std::string &error) {
+    z_stream z = {};
+    if (inflateInit2(&z, 15 + 16) != Z_OK) { // 15-bit window, gzip wrapper
+        error = "zlib initialisation failed";
+        return false;
+    }
+    std::size_t fed = 0;
+    bool ok = true;
+    for (;;) {
+        if (z.avail_in == 0 && fed < size) {
+            z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data + fed));
+            z.avail_in = static_cast<uInt>(std::min<std::size_t>(size - fed, 1 << 30));
+            fed += z.avail_in;
+        }
+        auto [p, n] = out.space();
+        z.next_out = reinterpret_cast<Bytef *>(p);
+        z.avail_out = static_cast<uInt>(n);
+        int rc = inflate(&z, Z_NO_FLUSH);
+        out.commit(n - z.avail_out);
+        if (rc == Z_STREAM_END) {
+            std::size_t left = z.avail_in + (size - fed);
+            const char *next = data + size - left;
+            if (left < 2 || detect_codec(next, left) != Codec::Gzip) break; // Done, or trailing padding
+            inflateReset(&z); // Another member follows, e.g. from pigz or cat a.gz b.gz
+        } else if (rc == Z_BUF_ERROR && z.avail_in == 0 && fed == size) {
+            error = "unexpected end of gzip data";
+            ok = false;
+            break;
+        } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+            error = z.msg ? z.msg : "corrupt gzip data";
+            ok = false;
+            break;
+        }
+    }
+    inflateEnd(&z);
+    return ok;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+/* zstd_range decodes one or more zstd frames. */
+bool zstd_range(const char *data, std::size_t size, SegmentWriter &out, std::string &error) {
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    if (stream == nullptr || ZSTD_isError(ZSTD_initDStream(stream))) {
+        ZSTD_freeDStream(stream);
+        error = "zstd initialisation failed";
+        return false;
+    }
+    ZSTD_inBuffer in = {data, size, 0};
+    std::size_t rc = 0;
+    for (;;) {
+        auto [p, n] = out.space();
+        ZSTD_outBuffer o = {p, n, 0};
+        rc = ZSTD_decompressStream(stream, &o, &in);
+        out.commit(o.pos);
+        if (ZSTD_isError(rc)) {
+            error = ZSTD_getErrorName(rc);
+            break;
+        }
+        if (in.pos == in.size && o.pos < o.size) break; // All input used and all output flushed
+    }
+    ZSTD_freeDStream(stream);
+    if (!ZSTD_isError(rc) && rc != 0) error = "unexpected end of zstd data";
+    return error.empty();
+}
+#endif
+
+/* bgzf_member_size returns the size of the BGZF gzip member at 'p', or 0 if it is not one. */
+std::size_t bgzf_member_size(const char *data, std::size_t avail) {
+    auto *p = reinterpret_cast<const unsigned char *>(data);
+    if (avail < 18 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !(p[3] & 4)) return 0; // Needs FEXTRA
+    std::size_t extraEnd = std::min<std::size_t>(12 + (p[10] | p[11] << 8), avail);
+    for (std::size_t i = 12; i + 4 <= extraEnd; ) {
+        std::size_t len = p[i + 2] | p[i + 3] << 8;
+        if (p[i] == 'B' && p[i + 1] == 'C' && len == 2 && i + 6 <= extraEnd) {
+            return (p[i + 4] | p[i + 5] << 8) + 1; // BSIZE is the member size minus one
+        }
+        i += 4 + len;
+    }
+    return 0;
+}
+
+/*
+ * decode_tasks cuts a file into byte ranges that decode independently:
+ * groups of whole BGZF members or zstd frames, fixed-size pieces of a plain
+ * file, or else the whole file as one range.
+ */
+std::vector<std::pair<std::size_t, std::size_t>> decode_tasks(Codec codec, const char *data, std::size_t size) {
+    std::vector<std::pair<std::size_t, std::size_t>> tasks;
+    if (codec == Codec::Plain) {
+        for (std::size_t begin = 0; begin < size; begin += kSegmentSize) {
+            tasks.emplace_back(begin, std::min(size, begin + kSegmentSize));
+        }
+        return tasks;
+    }
+
+    std::size_t begin = 0, pos = 0;
+    while (pos < size) {
+        std::size_t len = 0;
+        if (codec == Codec::Gzip) {
+            len = bgzf_member_size(data + pos, size - pos);
+#ifdef HAVE_ZSTD
+        } else {
+            std::size_t frame = ZSTD_findFrameCompressedSize(data + pos, size - pos);
+            len = ZSTD_isError(frame) ? 0 : frame;
+#endif
+        }
+        if (len == 0 || len > size - pos) { // Not splittable (or damaged): one decoder takes it all
+            return {{0, size}};
+        }
+        pos += len;
+        if (pos - begin >= kMinDecodeTask || pos == size) {
+            tasks.emplace_back(begin, pos);
+            begin = pos;
+        }
+    }
+    return tasks;
+}
+
+/* decode_range decodes the 'size' bytes at 'data', in the given format, into 'out'. */
+bool decode_range(Codec codec, const char *data, std::size_t size, SegmentWriter &out, std::string &error) {
+    switch (codec) {
+    case Codec::Plain:
+        for (std::size_t done = 0; done < size; ) {
+            auto [p, n] = out.space();
+            n = std::min(n, size - done);
+            std::memcpy(p, data + done, n);
+            out.commit(n);
+            done += n;
+        }
+        return true;
+    case Codec::Gzip:
+#ifdef HAVE_ZLIB
+        return inflate_range(data, size, out, error);
+#else
+        error = "this build has no gzip support (rebuild with zlib installed)";
+        return false;
+#endif
+    case Codec::Zstd:
+#ifdef HAVE_ZSTD
+        return zstd_range(data, size, out, error);
+#else
+        error = "this build has no zstd support (rebuild with libzstd installed)";
+        return false;
+#endif
+    }
+    return false;
+}
+
+/* The partial lines at either end of a Segment, kept for stitching. */
+struct SegmentEdges {
+    std::size_t task;
+    std::size_t part;
+    bool hasNewline;  // If not, the whole segment is the middle of one line, held in 'head'
+    std::string head; // Text before the first '\n'
+    std::string tail; // Text after the last '\n'
+};
+
+/*
+ * decode_file runs the decoder stage and the parse workers over one input
+ * file, adding to the tables in 'statsArray'. Returns false, with a message
+ * in 'error', if the file cannot be read or decoded.
+ */
+bool decode_file(const std::string &path, const Options &opts, std::vector<SyscallStats> &statsArray, std::string &error) {
+    MappedFile file;
+    if (!file.open(path.c_str())) {
+        error = "cannot open input file";
+        return false;
+    }
+    Codec codec = detect_codec(file.data(), file.size());
+    auto tasks = decode_tasks(codec, file.data(), file.size());
+
+    WorkQueue<Segment> queue(0, opts.maxMemory);
+    std::atomic<std::size_t> nextTask{0};
+    std::atomic<bool> failed{false};
+    std::mutex lock; // Guards 'error' and 'edges'
+    std::vector<SegmentEdges> edges;
+
+    auto decoder = [&]{
+        std::string message;
+        for (;;) {
+            std::size_t t = nextTask.fetch_add(1, std::memory_order_relaxed);
+            if (t >= tasks.size() || failed.load(std::memory_order_relaxed)) break;
+            SegmentWriter out(queue, t);
+            bool ok = decode_range(codec, file.data() + tasks[t].first, tasks[t].second - tasks[t].first, out, message);
+            out.flush();
+            if (!ok) {
+                std::lock_guard<std::mutex> guard(lock);
+                if (!failed.exchange(true)) error = message;
+                break;
+            }
+        }
+    };
+
+    auto parser = [&](std::size_t i) {
+        pin_worker(i, &statsArray[i]);
+        std::vector<Segment> batch;
+        while (queue.pop_batch(batch, 1)) {
+            for (Segment &segment : batch) {
+                const char *text = segment.text.data();
+                std::size_t size = segment.text.size();
+                const char *first = static_cast<const char *>(std::memchr(text, '\n', size));
+                SegmentEdges e{segment.task, segment.part, first != nullptr, {}, {}};
+                if (first == nullptr) {
+                    e.head = std::move(segment.text);
+                } else {
+                    std::size_t headEnd = first - text + 1;
+                    std::size_t tailStart = static_cast<const char *>(memrchr(text, '\n', size)) - text + 1;
+                    e.head.assign(text, headEnd - 1);
+                    e.tail.assign(text + tailStart, size - tailStart);
+                    parse_range(text, headEnd, tailStart, statsArray[i]);
+                }
+                std::lock_guard<std::mutex> guard(lock);
+                edges.push_back(std::move(e));
+            }
+        }
+    };
+
+    std::size_t numDecoders = std::min<std::size_t>(statsArray.size(), std::max<std::size_t>(tasks.size(), 1));
+    std::vector<std::thread> decoders, parsers;
+    for (std::size_t d = 0; d < numDecoders; d++) {
+        decoders.emplace_back(decoder);
+    }
+    for (std::size_t i = 0; i < statsArray.size(); i++) {
+        parsers.emplace_back(parser, i);
+    }
+    for (auto &t : decoders) {
+        t.join();
+    }
+    queue.close();
+    for (auto &t : parsers) {
+        t.join();
+    }
+    if constexpr (kProfile) note_queue(queue.report());
+    if (failed) return false;
+
+    // Join each segment's last partial line to the next one's first
+    std::sort(edges.begin(), edges.end(), [](const SegmentEdges &a, const SegmentEdges &b) {
+        return a.task != b.task ? a.task < b.task : a.part < b.part;
+    });
+    std::string carry;
+    for (SegmentEdges &e : edges) {
+        carry += e.head;
+        if (!e.hasNewline) continue;
+        parse_range(carry.data(), 0, carry.size(), statsArray[0]);
+        carry = std::move(e.tail);
+    }
+    parse_range(carry.data(), 0, carry.size(), statsArray[0]);
+    return true;
+}
+
+/*
+ * file_tables makes the tables run_decode and run_cached parse one input
+ * into before merging them into 'statsArray'. Under --aggregate=shared they
+ * count into the same shared table, so --snapshots sees the input while it
+ * is being parsed.
+ */
+std::vector<SyscallStats> file_tables(const std::vector<SyscallStats> &statsArray) {
+    std::vector<SyscallStats> tables(statsArray.size());
+    if (!statsArray.empty() && statsArray[0].shared) statsArray[0].shared->attach(tables);
+    return tables;
+}
+
+/*
+ * run_decode analyses inputs of which at least one is compressed. The files
+ * are decoded one after another, each by the whole decoder and parser pool;
+ * plain inputs in the same run go through the same stage.
+ */
+bool run_decode(const Options &opts, std::vector<SyscallStats> &statsArray, std::vector<SyscallStats> &perFile) {
+    if (opts.perFile) perFile = std::vector<SyscallStats>(opts.traceFiles.size());
+    for (std::size_t f = 0; f < opts.traceFiles.size(); f++) {
+        std::vector<SyscallStats> fileStats = file_tables(statsArray);
+        SyscallStats before = opts.perFile ? merge_all(fileStats) : SyscallStats{}; // Shared: the other inputs' counts
+        std::string error;
+        if (!decode_file(opts.traceFiles[f], opts, fileStats, error)) {
+            std::cerr << "Error: " << opts.traceFiles[f] << ": " << error << "\n";
+            return false;
+        }
+        for (std::size_t i = 0; i < statsArray.size(); i++) {
+            merge_stats(statsArray[i], fileStats[i]);
+        }
+        if (opts.perFile) perFile[f] = counts_since(merge_all(fileStats), before);
+    }
+    return true;
+}
+
+/*
+ * Trace cache (--cache)
+ *
+ * The first run over a trace writes a sidecar, <trace>.sidx, holding every
+ * counted line as a row of fixed-width columns. Later runs map the sidecar
+ * and aggregate from the columns without touching the text. The header
+ * records the source's size and mtime, and the sidecar is rebuilt whenever
+ * either changes (or the syscall table it was encoded against does).
+ *
+ * Layout, every array starting on an 8-byte boundary:
+ *
+ *   SidxHeader
+ *   chunkEnds  uint64[chunks]
+ *   id         uint16[rows]   dense syscall ID, or kSyscallCount + name index
+ *   kind       uint8[rows]    RowKind
+ *   errno      uint8[rows]
+ *   result     int32[rows]
+ *   pid        int32[rows]
+ *   timestamp  uint64[rows]   ns, kNoValue if none
+ *   duration   uint64[rows]   ns, kNoValue if none
+ *   names      for each unknown name: uint32 length, then the bytes
+ */
+struct SidxHeader {
+    char magic[8];
+    std::uint64_t sourceSize;
+    std::uint64_t sourceMtimeNs;
+    std::uint64_t syscallCount; // kSyscallCount of the build that wrote it
+    std::uint64_t rows;
+    std::uint64_t chunks;
+    std::uint64_t names;
+    std::uint64_t namesBytes;
+};
+
+constexpr char kSidxMagic[8] = {'S', 'T', 'R', 'S', 'I', 'D', 'X', '1'};
+
+/* Byte offsets of the arrays of a sidecar with the given header. */
+struct SidxLayout {
+    std::size_t chunkEnds, id, kind, errnoId, result, pid, timestampNs, durationNs, names, total;
+
+    explicit SidxLayout(const SidxHeader &h) {
+        auto align = [](std::size_t n) { return (n + 7) & ~std::size_t(7); };
+        chunkEnds = sizeof(SidxHeader);
+        id = align(chunkEnds + h.chunks * 8);
+        kind = align(id + h.rows * 2);
+        errnoId = align(kind + h.rows);
+        result = align(errnoId + h.rows);
+        pid = align(result + h.rows * 4);
+        timestampNs = align(pid + h.rows * 4);
+        durationNs = timestampNs + h.rows * 8;
+        names = durationNs + h.rows * 8;
+        total = names + h.namesBytes;
+    }
+};
+
+std::string sidx_path(const std::string &trace) {
+    return trace + ".sidx";
+}
+
+/* source_identity reads the size and mtime a sidecar of 'path' must match. */
+bool source_identity(const std::string &path, std::uint64_t &size, std::uint64_t &mtimeNs) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    size = st.st_size;
+    mtimeNs = std::uint64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+/*
+ * write_sidx writes the rows captured by every worker as the sidecar of
+ * 'trace'. Unknown names are renumbered into one dictionary. The file is
+ * written under a temporary name and renamed, so a reader never sees half of
+ * it. Returns false if it could not be written.
+ */
+bool write_sidx(const std::string &trace, const std::vector<SyscallStats> &statsArray) {
+    SidxHeader h = {};
+    std::memcpy(h.magic, kSidxMagic, sizeof(h.magic));
+    if (!source_identity(trace, h.sourceSize, h.sourceMtimeNs)) return false;
+    h.syscallCount = kSyscallCount;
+
+    std::vector<std::string_view> names;
+    std::unordered_map<std::string_view, std::uint16_t> nameIds;
+    std::vector<std::vector<std::uint16_t>> remap(statsArray.size()); // Worker's name index -> dictionary index
+    for (std::size_t w = 0; w < statsArray.size(); w++) {
+        const RowCapture &rows = *statsArray[w].rows;
+        if (rows.overflow || rows.spillFailed) return false;
+        h.rows += rows.size();
+        h.chunks += rows.chunkEnds.size();
+        for (const std::string &name : rows.names) {
+            auto [it, added] = nameIds.emplace(name, static_cast<std::uint16_t>(names.size()));
+            if (added) {
+                names.push_back(name);
+                h.namesBytes += 4 + name.size();
+            }
+            remap[w].push_back(it->second);
+        }
+    }
+    h.names = names.size();
+
+    std::string tmp = sidx_path(trace) + ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    std::size_t written = 0;
+    auto put = [&](const void *p, std::size_t n) {
+        out.write(static_cast<const char *>(p), n);
+        written += n;
+    };
+    auto pad = [&] {
+        static const char zeros[8] = {};
+        put(zeros, (8 - written % 8) % 8);
+    };
+
+    put(&h, sizeof(h));
+    std::uint64_t rowBase = 0;
+    for (const auto &stats : statsArray) {
+        for (std::uint64_t end : stats.rows->chunkEnds) {
+            std::uint64_t global = rowBase + end;
+            put(&global, sizeof(global));
+        }
+        rowBase += stats.rows->size();
+    }
+    pad();
+    // Each column is the workers' rows one after another: what they spilled, then what is still in memory
+    bool readBack = true;
+    for_each_row_column([&](std::size_t c, auto member) {
+        std::remove_reference_t<decltype(std::declval<RowCapture &>().*member)> block;
+        for (std::size_t w = 0; w < statsArray.size() && readBack; w++) {
+            const RowCapture &rows = *statsArray[w].rows;
+            auto emit = [&] {
+                if constexpr (std::is_same_v<decltype(member), decltype(&RowCapture::id)>) {
+                    for (auto &id : block) {
+                        if (id >= kSyscallCount) id = static_cast<std::uint16_t>(kSyscallCount + remap[w][id - kSyscallCount]);
+                    }
+                }
+                put(block.data(), block.size() * sizeof(block[0]));
+            };
+            if (rows.spill[c]) std::rewind(rows.spill[c]);
+            for (std::uint64_t left = rows.spilledRows; left > 0 && readBack; left -= block.size()) {
+                block.resize(std::min<std::uint64_t>(left, kSpillRows));
+                readBack = std::fread(block.data(), sizeof(block[0]), block.size(), rows.spill[c]) == block.size();
+                if (readBack) emit();
+            }
+            block = rows.*member;
+            emit();
+        }
+        pad();
+    });
+    for (std::string_view name : names) {
+        std::uint32_t len = static_cast<std::uint32_t>(name.size());
+        put(&len, sizeof(len));
+        put(name.data(), name.size());
+    }
+    out.close();
+    if (!out || !readBack || written != SidxLayout(h).total || rename(tmp.c_str(), sidx_path(trace).c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+/* SidxView gives typed access to the columns of a mapped sidecar. */
+struct SidxView {
+    SidxHeader header;
+    const std::uint64_t *chunkEnds;
+    const std::uint16_t *id;
+    const std::uint8_t *kind;
+    const std::uint8_t *errnoId;
+    const std::int32_t *result;
+    const std::int32_t *pid;
+    const std::uint64_t *timestampNs;
+    const std::uint64_t *durationNs;
+    std::vector<std::string_view> names;
+};
+
+/*
+ * open_sidx checks that 'file' is a well-formed sidecar of 'trace' as it is
+ * now, and fills 'view'. Returns false if it is stale or damaged.
+ */
+bool open_sidx(const MappedFile &file, const std::string &trace, SidxView &view) {
+    SidxHeader &h = view.header;
+    if (file.size() < sizeof(SidxHeader)) return false;
+    std::memcpy(&h, file.data(), sizeof(h));
+    std::uint64_t size, mtimeNs;
+    if (std::memcmp(h.magic, kSidxMagic, sizeof(h.magic)) != 0 || !source_identity(trace, size, mtimeNs) ||
+        h.sourceSize != size || h.sourceMtimeNs != mtimeNs || h.syscallCount != kSyscallCount ||
+        h.rows > file.size() || h.chunks > file.size() || h.namesBytes > file.size()) {
+        return false;
+    }
+    SidxLayout layout(h);
+    if (layout.total != file.size()) return false;
+
+    const char *base = file.data();
+    view.chunkEnds = reinterpret_cast<const std::uint64_t *>(base + layout.chunkEnds);
+    view.id = reinterpret_cast<const std::uint16_t *>(base + layout.id);
+    view.kind = reinterpret_cast<const std::uint8_t *>(base + layout.kind);
+    view.errnoId = reinterpret_cast<const std::uint8_t *>(base + layout.errnoId);
+    view.result = reinterpret_cast<const std::int32_t *>(base + layout.result);
+    view.pid = reinterpret_cast<const std::int32_t *>(base + layout.pid);
+    view.timestampNs = reinterpret_cast<const std::uint64_t *>(base + layout.timestampNs);
+    view.durationNs = reinterpret_cast<const std::uint64_t *>(base + layout.durationNs);
+
+    const char *p = base + layout.names, *end = base + layout.total;
+    for (std::uint64_t n = 0; n < h.names; n++) {
+        std::uint32_t len;
+        if (end - p < 4) return false;
+        std::memcpy(&len, p, 4);
+        if (static_cast<std::size_t>(end - p - 4) < len) return false;
+        view.names.emplace_back(p + 4, len);
+        p += 4 + len;
+    }
+    for (std::uint64_t c = 0; c < h.chunks; c++) {
+        if (view.chunkEnds[c] > h.rows || (c > 0 && view.chunkEnds[c] < view.chunkEnds[c - 1])) return false;
+    }
+    for (std::uint64_t r = 0; r < h.rows; r++) {
+        if (view.id[r] >= kSyscallCount + view.names.size() || view.errnoId[r] > kOtherErrno) return false;
+    }
+    return true;
+}
+
+/*
+ * replay_counts aggregates rows [begin, end) when only counts and fails are
+ * wanted: a tight loop over the id, kind and result columns.
+ */
+void replay_counts(const SidxView &view, std::uint64_t begin, std::uint64_t end, SyscallStats &stats) {
+    std::array<Stats, kSyscallCount> known{};
+    std::vector<Stats> unknown(view.names.size());
+    for (std::uint64_t r = begin; r < end; r++) {
+        std::uint16_t id = view.id[r];
+        std::uint64_t counted = (view.kind[r] != kUnfinishedHalf);
+        std::uint64_t failed = counted & (view.result[r] < 0);
+        Stats &s = (id < kSyscallCount) ? known[id] : unknown[id - kSyscallCount];
+        s.count += counted;
+        s.fails += failed;
+    }
+    SyscallStats replayed; // Added in one go, through the shared table if the worker has one
+    std::copy(known.begin(), known.end(), replayed.known.begin());
+    for (std::size_t n = 0; n < unknown.size(); n++) {
+        if (unknown[n].count != 0) replayed.unknown.emplace(view.names[n], unknown[n]);
+    }
+    merge_counts(stats, replayed);
+}
+
+/* replay_rows feeds chunks [firstChunk, lastChunk) back through count_line, as the parse did. */
+void replay_rows(const SidxView &view, std::size_t firstChunk, std::size_t lastChunk, SyscallStats &stats) {
+    ParsedLine parsed;
+    PendingCalls pending;
+    std::uint64_t r = firstChunk == 0 ? 0 : view.chunkEnds[firstChunk - 1];
+    for (std::size_t c = firstChunk; c < lastChunk; c++) {
+        for (; r < view.chunkEnds[c]; r++) {
+            std::uint16_t id = view.id[r];
+            parsed.syscall = (id < kSyscallCount) ? kSortedSyscalls[id] : view.names[id - kSyscallCount];
+            parsed.result = view.result[r];
+            parsed.pid = view.pid[r];
+            parsed.resumed = (view.kind[r] == kResumedHalf);
+            parsed.errnoId = view.errnoId[r];
+            parsed.stamped = (view.timestampNs[r] != kNoValue);
+            parsed.timestampNs = view.timestampNs[r];
+            parsed.timed = (view.durationNs[r] != kNoValue);
+            parsed.durationNs = view.durationNs[r];
+            count_line(stats, view.kind[r] == kUnfinishedHalf ? ParseStatus::Unfinished : ParseStatus::Ok, parsed, pending);
+        }
+        end_chunk(stats, pending);
+    }
+}
+
+/*
+ * aggregate_sidx spreads the sidecar's chunks over the workers, in runs of
+ * roughly equal row counts, and aggregates each run into the worker's table.
+ * With only counts wanted the chunk structure does not matter, so the rows
+ * are simply split evenly. With --pin, thread i runs where worker i would.
+ */
+void aggregate_sidx(const SidxView &view, bool countsOnly, std::vector<SyscallStats> &statsArray) {
+    std::size_t n = statsArray.size();
+    std::uint64_t rows = view.header.rows;
+    std::vector<std::thread> threads;
+    if (countsOnly) {
+        for (std::size_t i = 0; i < n; i++) {
+            threads.emplace_back([&view, &statsArray, i, rows, n] {
+                pin_worker(i, &statsArray[i]);
+                replay_counts(view, rows * i / n, rows * (i + 1) / n, statsArray[i]);
+            });
+        }
+    } else {
+        std::size_t first = 0;
+        for (std::size_t i = 0; i < n && first < view.header.chunks; i++) {
+            std::size_t last = first;
+            std::uint64_t target = rows * (i + 1) / n;
+            while (last < view.header.chunks && (last == first || view.chunkEnds[last - 1] < target || i == n - 1)) last++;
+            threads.emplace_back([&view, &statsArray, i, first, last] {
+                pin_worker(i, &statsArray[i]);
+                replay_rows(view, first, last, statsArray[i]);
+            });
+            first = last;
+        }
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+/*
+ * run_cached analyses each input from its sidecar when that is up to date,
+ * and otherwise parses it (through the decode stage, so compressed inputs
+ * work too) while capturing rows, then writes a fresh sidecar.
+ */
+bool run_cached(const Options &opts, std::vector<SyscallStats> &statsArray, std::vector<SyscallStats> &perFile) {
+    bool countsOnly = !opts.perPid && !opts.latency && !opts.errors && opts.timeline == 0 && !rowFilter.active();
+    if (opts.perFile) perFile = std::vector<SyscallStats>(opts.traceFiles.size());
+    for (std::size_t f = 0; f < opts.traceFiles.size(); f++) {
+        const std::string &trace = opts.traceFiles[f];
+        std::vector<SyscallStats> fileStats = file_tables(statsArray);
+        SyscallStats before = opts.perFile ? merge_all(fileStats) : SyscallStats{}; // Shared: the other inputs' counts
+
+        MappedFile sidx;
+        SidxView view;
+        if (sidx.open(sidx_path(trace).c_str()) && open_sidx(sidx, trace, view)) {
+            aggregate_sidx(view, countsOnly, fileStats);
+        } else {
+            for (auto &stats : fileStats) {
+                stats.rows = std::make_unique<RowCapture>();
+            }
+            std::string error;
+            if (!decode_file(trace, opts, fileStats, error)) {
+                std::cerr << "Error: " << trace << ": " << error << "\n";
+                return false;
+            }
+            if (!write_sidx(trace, fileStats)) {
+                std::cerr << "Warning: cannot write cache file: " << sidx_path(trace) << "\n";
+            }
+            for (auto &stats : fileStats) {
+                stats.rows.reset();
+            }
+        }
+        for (std::size_t i = 0; i < statsArray.size(); i++) {
+            merge_stats(statsArray[i], fileStats[i]);
+        }
+        if (opts.perFile) perFile[f] = counts_since(merge_all(fileStats), before);
+    }
+    return true;
+}
+
+/*
+ * write_report writes everything the options ask for about 'stats': the
+ * counts, then (text only, see parse_options) the latency, errno and top
+ * argument reports, then the filter report, the per-file and per-pid counts,
+ * and the timeline. A one-shot run writes it once; --follow writes it for each
+ * update, tagged with 'label'. With --deltas, 'prev' is the last update and
+ * the counts become increments since then, while the other reports still
+ * cover the whole trace so far. Returns false if the report could not be
+ * written.
+ */
+bool write_report(ReportWriter &report, SyscallStats &stats, const Options &opts, const std::vector<SyscallStats> &perFile,
+                  const ReportWriter::Label &label, const SyscallStats *prev) {
+    const LineFilter &filter = opts.cache ? rowFilter : lineFilter;
+    std::vector<CountSection> sections;
+    sections.push_back(prev ? delta_section(stats, *prev) : count_section(stats));
+    if (opts.format == OutputFormat::Text) {
+        report.write(sections, label);
+        sections.clear();
+        if (opts.latency) {
+            print_latency(report.out(), stats);
+        }
+        if (opts.errors) {
+            print_errors(report.out(), stats);
+        }
+        if (opts.top != 0) {
+            print_top_args(report.out(), stats);
+        }
+        if (filter.active()) {
+            report.write({filter_section(stats, filter)});
+        }
+    } else if (filter.active()) {
+        sections.push_back(filter_section(stats, filter));
+    }
+    for (std::size_t f = 0; f < perFile.size(); f++) {
+        sections.push_back(count_section(perFile[f], CountSection::File, opts.traceFiles[f]));
+    }
+    if (opts.perPid) {
+        auto pids = pid_sections(stats.byPid);
+        if (prev) pids = delta_pid_sections(pids, pid_sections(prev->byPid));
+        sections.insert(sections.end(), std::make_move_iterator(pids.begin()), std::make_move_iterator(pids.end()));
+    }
+    if (opts.format != OutputFormat::Text) {
+        report.write(sections, label);
+    } else if (!sections.empty()) {
+        report.write(sections, ReportWriter::Label{{}, 0, 0, label.delta}); // The heading went out with the counts
+    }
+    if (!report.flush()) {
+        std::cerr << "Error: cannot write the report\n";
+        return false;
+    }
+    if (opts.timeline != 0) {
+        unwrap_midnight(stats.timeline);
+        if (opts.timelineOut.empty()) {
+            std::cout << "\n== timeline ==\n";
+            print_timeline(std::cout, stats.timeline, opts.timelineJson);
+            std::cout.flush(); // The next report goes straight to the fd
+        } else {
+            std::ofstream out(opts.timelineOut); // Under --follow, the latest update's timeline
+            print_timeline(out, stats.timeline, opts.timelineJson);
+            if (!out) {
+                std::cerr << "Error: cannot write timeline to: " << opts.timelineOut << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Set by SIGINT/SIGTERM to end --follow cleanly. */
+volatile std::sig_atomic_t stopFollowing = 0;
+
+void handle_stop_signal(int) {
+    stopFollowing = 1;
+}
+
+/* Bytes read from the followed file per pread. */
+constexpr std::size_t kFollowReadSize = 64 << 20;
+
+/*
+ * run_follow keeps the trace open and analyses it as strace appends to it.
+ * inotify wakes us when the file changes (with a timed poll as a fallback),
+ * and only the bytes added since the last wake-up are read and parsed. A
+ * partial last line is kept until its '\n' arrives. Every --interval seconds
+ * the whole report (see write_report) is reprinted, or with --deltas the
+ * counts and per-pid counts are just what changed since the last one. Stops on SIGINT/SIGTERM or when the file is deleted or moved, and then
+ * prints a final full report.
+ */
+bool run_follow(const Options &opts) {
+    int fd = ::open(opts.traceFile.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: cannot open input file: "
+                  << opts.traceFile << "\n";
+        return false;
+    }
+
+    int inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd >= 0 && inotify_add_watch(inotifyFd, opts.traceFile.c_str(),
+                                            IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF) < 0) {
+        ::close(inotifyFd);
+        inotifyFd = -1;
+    }
+    if (inotifyFd < 0) {
+        std::cerr << "Warning: inotify unavailable, checking for new data every interval.\n";
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = handle_stop_signal; // No SA_RESTART, so poll() returns early on a signal
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    std::vector<SyscallStats> statsArray(opts.numThreads);
+    std::unique_ptr<SharedStats> shared;
+    if (opts.sharedStats) {
+        shared = std::make_unique<SharedStats>(statsArray.size());
+        shared->attach(statsArray);
+    }
+    SyscallStats lastReport;
+    std::vector<char> pending; // Unparsed bytes: the tail of the last read without its '\n' yet
+    off_t offset = 0;
+    std::uint64_t updates = 0;
+    bool gone = false;
+
+    auto merged = [&]{ return merge_all(statsArray); };
+    ReportWriter report(opts.format);
+    const std::vector<SyscallStats> noFiles; // One input, so no per-file sections
+
+    auto readNew = [&]{
+        struct stat st;
+        if (fstat(fd, &st) != 0) return;
+        if (st.st_nlink == 0) gone = true; // Unlinked: our fd keeps it alive, so IN_DELETE_SELF never comes
+        if (st.st_size < offset) { // Truncated, e.g. strace -o restarted on the same file
+            std::cerr << "Warning: " << opts.traceFile << " was truncated, starting over.\n";
+            offset = 0;
+            pending.clear();
+            statsArray = std::vector<SyscallStats>(statsArray.size());
+            if (shared) {
+                shared->reset();
+                shared->attach(statsArray);
+            }
+            lastReport = SyscallStats{};
+        }
+        while (offset < st.st_size) {
+            std::size_t carry = pending.size();
+            std::size_t want = std::min<std::size_t>(kFollowReadSize, st.st_size - offset);
+            pending.resize(carry + want);
+            ssize_t n = pread(fd, pending.data() + carry, want, offset);
+            if (n <= 0) {
+                pending.resize(carry);
+                return;
+            }
+            pending.resize(carry + n);
+            offset += n;
+
+            const void *nl = memrchr(pending.data(), '\n', pending.size());
+            if (nl == nullptr) continue; // Still inside one line, keep reading
+            std::size_t complete = static_cast<const char *>(nl) - pending.data() + 1;
+            parse_parallel(pending.data(), complete, statsArray);
+            pending.erase(pending.begin(), pending.begin() + complete);
+        }
+    };
+
+    auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(opts.followInterval));
+    auto nextReport = std::chrono::steady_clock::now() + interval;
+
+    for (;;) {
+        readNew();
+        if (stopFollowing || gone) break;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextReport) {
+            SyscallStats current = merged();
+            std::uint64_t before = 0, after = 0;
+            for_each_stat(lastReport, [&](std::string_view, const Stats &st) { before += st.count; });
+            for_each_stat(current, [&](std::string_view, const Stats &st) { after += st.count; });
+            if (after != before) { // Stay quiet while nothing new has been traced
+                ReportWriter::Label label{"update", ++updates, static_cast<std::uint64_t>(offset), opts.followDeltas};
+                write_report(report, current, opts, noFiles, label, opts.followDeltas ? &lastReport : nullptr);
+                lastReport = std::move(current);
+            }
+            nextReport = now + interval;
+            continue;
+        }
+
+        auto waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(nextReport - now).count() + 1;
+        struct pollfd pfd = {inotifyFd, POLLIN, 0};
+        if (poll(&pfd, inotifyFd >= 0 ? 1 : 0, static_cast<int>(waitMs)) > 0) {
+            alignas(struct inotify_event) char events[4096];
+            ssize_t len;
+            while ((len = read(inotifyFd, events, sizeof(events))) > 0) { // Drain; we re-read the file regardless
+                for (char *p = events; p < events + len; ) {
+                    auto *ev = reinterpret_cast<struct inotify_event *>(p);
+                    if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) gone = true;
+                    p += sizeof(struct inotify_event) + ev->len;
+                }
+            }
+        }
+    }
+
+    if (!pending.empty()) { // Like getline, count a final line that never got its '\n'
+        parse_range(pending.data(), 0, pending.size(), statsArray[0]);
+    }
+    if (inotifyFd >= 0) ::close(inotifyFd);
+    ::close(fd);
+
+    SyscallStats finalStats = merged();
+    return write_report(report, finalStats, opts, noFiles, ReportWriter::Label{"final", updates + 1, static_cast<std::uint64_t>(offset)}, nullptr);
+}
+
+/*
+ * SnapshotReporter writes the counts in a SharedStats to 'report' every
+ * --snapshots seconds from its own thread, while the workers carry on
+ * counting, until stop().
+ */
+class SnapshotReporter {
+public:
+    SnapshotReporter(const SharedStats &table, ReportWriter &report, double seconds)
+        : table_(table), report_(report), start_(std::chrono::steady_clock::now()),
+          interval_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds))),
+          thread_([this]{ run(); }) {}
+    SnapshotReporter(const SnapshotReporter &) = delete;
+    SnapshotReporter &operator=(const SnapshotReporter &) = delete;
+    ~SnapshotReporter() { stop(); }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        if (thread_.joinable()) thread_.join();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (std::uint64_t n = 1; !wake_.wait_for(lock, interval_, [this]{ return stopping_; }); n++) {
+            SyscallStats current = table_.snapshot();
+            std::vector<CountSection> sections;
+            sections.push_back(count_section(current));
+            if (trackPids) {
+                auto pids = pid_sections(current.byPid);
+                sections.insert(sections.end(), std::make_move_iterator(pids.begin()), std::make_move_iterator(pids.end()));
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_);
+            report_.write(sections, ReportWriter::Label{"snapshot", n, static_cast<std::uint64_t>(elapsed.count()), false, "ms"});
+            report_.flush();
+        }
+    }
+
+    const SharedStats &table_;
+    ReportWriter &report_;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::duration interval_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::thread thread_; // Last, so it starts once everything it uses is set up
+};
+
+/* How often the --threads auto controller samples the pipeline. */
+constexpr auto kElasticInterval = std::chrono::milliseconds(50);
+
+/*
+ * ElasticPool decides how many of the pipeline's workers run, for
+ * --threads auto. Every kElasticInterval its controller compares the time
+ * the producer spent blocked on a full queue, the time the active workers
+ * spent waiting for lines, and the queue depth, then
+ *   - wakes one more worker when the workers were busy (idle under 25%)
+ *     and lines are backing up: the producer stalled for over 10% of the
+ *     interval, or the queue grew, and
+ *   - parks one when the workers were idle for over half the interval and
+ *     the queue is empty, i.e. the reader is what limits the run.
+ * Parked workers sleep on a condition variable. Each change is kept in a
+ * history so the report shows where the count settled.
+ */
+class ElasticPool {
+public:
+    explicit ElasticPool(std::size_t maxWorkers)
+        : idle_(std::max<std::size_t>(maxWorkers, 1)), start_(std::chrono::steady_clock::now()) {
+        history_.emplace_back(0, 1);
+    }
+
+    /* wait_turn parks worker i until it is one of the active workers, or the run is over. */
+    void wait_turn(std::size_t i) {
+        if (i < active_.load(std::memory_order_relaxed)) return;
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [&]{ return i < active_.load(std::memory_order_relaxed) || done_; });
+    }
+
+    /* add_idle is called by worker i with the time it just spent waiting for lines. */
+    void add_idle(std::size_t i, std::chrono::nanoseconds t) {
+        idle_[i].ns.fetch_add(t.count(), std::memory_order_relaxed);
+    }
+
+    /* control runs the controller on the calling thread until finish() is called. */
+    template <typename Queue>
+    void control(Queue &queue) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::vector<std::int64_t> lastIdle(idle_.size(), 0);
+        std::int64_t lastBlocked = queue.producer_blocked().count();
+        std::size_t lastDepth = 0;
+        auto last = std::chrono::steady_clock::now();
+        while (!cv_.wait_for(lock, kElasticInterval, [&]{ return done_; })) {
+            auto now = std::chrono::steady_clock::now();
+            double interval = std::chrono::duration<double, std::nano>(now - last).count();
+            last = now;
+            std::size_t active = active_.load(std::memory_order_relaxed);
+            std::int64_t idle = 0;
+            for (std::size_t i = 0; i < idle_.size(); i++) {
+                std::int64_t total = idle_[i].ns.load(std::memory_order_relaxed);
+                if (i < active) idle += total - lastIdle[i];
+                lastIdle[i] = total;
+            }
+            std::int64_t blocked = queue.producer_blocked().count();
+            std::size_t depth = queue.depth();
+            double idleShare = idle / (interval * active);
+            double stallShare = (blocked - lastBlocked) / interval;
+            lastBlocked = blocked;
+
+            std::size_t next = active;
+            if (idleShare < 0.25 && (stallShare > 0.1 || depth > lastDepth) && active < idle_.size()) next++;
+            else if (idleShare > 0.5 && depth == 0 && active > 1) next--;
+            lastDepth = depth;
+            if (next != active) {
+                active_.store(next, std::memory_order_relaxed);
+                history_.emplace_back(std::chrono::duration_cast<std::chrono::milliseconds>(now - start_).count(), next);
+                cv_.notify_all();
+            }
+        }
+    }
+
+    /* finish stops the controller and releases every parked worker to drain the queue. */
+    void finish() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+        cv_.notify_all();
+    }
+
+    /* print_report writes the thread count over time, e.g. "threads: auto (max 8): 1@0ms 2@50ms 3@100ms". */
+    void print_report(std::ostream &out) const {
+        out << "threads: auto (max " << idle_.size() << "):";
+        for (const auto &[ms, count] : history_) {
+            out << " " << count << "@" << ms << "ms";
+        }
+        out << "\n";
+    }
+
+private:
+    struct alignas(kCacheLine) IdleCounter {
+        std::atomic<std::int64_t> ns{0}; // Written by one worker only
+    };
+
+    std::vector<IdleCounter> idle_;
+    std::atomic<std::size_t> active_{1};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool done_ = false;
+    std::chrono::steady_clock::time_point start_;
+    std::vector<std::pair<std::int64_t, std::size_t>> history_; // (ms since start, active workers)
+};
+
+/*======================Start of my code (2)=========================*/
+/*
+ * run_pipeline is the original pipeline: this thread reads lines with getline
+ * and pushes them to a queue that the worker threads drain. It works with any
+ * queue offering push_batch/pop_batch/close (WorkQueue or RingQueue). With a
+ * 'pool' (--threads auto) only the workers it has made active take lines.
+ */
+template <typename Queue>
+void run_pipeline(Queue &workQueue, std::istream &infile, const Options &opts, std::vector<SyscallStats> &statsArray,
+                  ElasticPool *pool = nullptr) {
+    int numThreads = opts.numThreads;
+
+    // Thread-wise analysis
+    std::vector<std::thread> threads; // Store an Array of active Threads
+
+    std::size_t batchSize = opts.batchSize;
+
+    threads.reserve(numThreads); // Reserve (numThreads) threads for use
+    for(int i = 0; i < numThreads; i++){
+        threads.emplace_back([&workQueue, &statsArray, i, batchSize, pool](){ // Add [numThreads] threads to the threads array with pointers to the workQueue and stats tables, and an index
+            std::vector<std::string> lines;
+            lines.reserve(batchSize);
+            ParsedLine parsed;
+            PendingCalls pending; // Batches are not contiguous for one worker, so split calls are paired per batch
+            pin_worker(i, &statsArray[i]);
+            for(;;){
+                std::chrono::steady_clock::time_point waitStart;
+                if (pool) {
+                    pool->wait_turn(i);
+                    waitStart = std::chrono::steady_clock::now();
+                }
+                if (!workQueue.pop_batch(lines, batchSize)) break; // Stop once the workQueue is empty and closed. This is how the threads wait for work.
+                if (pool) pool->add_idle(i, std::chrono::steady_clock::now() - waitStart);
+                for(const auto &line : lines){
+                    count_line(statsArray[i], parse_line(line, parsed), parsed, pending); // Parse the line from pop and update the stats
+                }
+                end_chunk(statsArray[i], pending);
+            }
+        });
+    }
+
+    std::thread controller;
+    if (pool) controller = std::thread([&workQueue, pool](){ pool->control(workQueue); });
+
+    std::vector<std::string> batch;
+    batch.reserve(batchSize);
+    std::string line;
+    auto readStart = std::chrono::steady_clock::now();
+    std::uint64_t readBytes = 0;
+    while(std::getline(infile, line)){
+        if constexpr (kProfile) readBytes += line.size() + 1;
+        batch.push_back(std::move(line));  // Collect lines from the input ...
+        if(batch.size() >= batchSize){
+            workQueue.push_batch(batch); // ... and push them to the queue a batch at a time
+        }
+    }
+    workQueue.push_batch(batch); // Push whatever is left over
+    if constexpr (kProfile) {
+        pipelineProfile.readerBytes += readBytes;
+        pipelineProfile.readerTime += std::chrono::steady_clock::now() - readStart; // run_queue takes off the blocked time
+    }
+
+    workQueue.close(); // Close the workQueue. Wake up the threads so they can finish popping.
+    if (pool) {
+        pool->finish();
+        controller.join();
+    }
+
+    for(auto &t : threads){
+        t.join(); // Rejoin all of the threads
+    }
+}
+
+bool run_queue(const Options &opts, std::vector<SyscallStats> &statsArray) {
+    std::ifstream infile(opts.traceFile);
+    if (!infile) {
+        std::cerr << "Error: cannot open input file: "
+                  << opts.traceFile << "\n";
+        return false;
+    }
+
+    QueueReport report;
+    std::unique_ptr<ElasticPool> pool;
+    if (opts.autoThreads) pool = std::make_unique<ElasticPool>(statsArray.size());
+    if (opts.useRing) {
+        RingQueue workQueue(opts.maxQueued != 0 ? opts.maxQueued : 1 << 14);
+        run_pipeline(workQueue, infile, opts, statsArray, pool.get());
+        report = workQueue.report();
+    } else {
+        WorkQueue workQueue(opts.maxQueued, opts.maxMemory);
+        run_pipeline(workQueue, infile, opts, statsArray, pool.get());
+        report = workQueue.report();
+    }
+    if (pool) pool->print_report(std::cerr);
+    if constexpr (kProfile) {
+        note_queue(report);
+        pipelineProfile.readerTime -= std::min(pipelineProfile.readerTime, report.producerBlocked); // Busy time only
+    }
+
+    if (opts.queueReport) {
+        auto blockedMs = std::chrono::duration_cast<std::chrono::milliseconds>(report.producerBlocked);
+        std::cerr << "queue: " << (opts.useRing ? "ring" : "mutex")
+                  << ", producer blocked=" << blockedMs.count() << "ms"
+                  << ", high-water=" << report.highWaterItems << " lines";
+        if (!opts.useRing) std::cerr << " / " << report.highWaterBytes << " bytes";
+        std::cerr << "\n";
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    if (!parse_options(argc, argv, opts)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<CpuInfo> cpus = discover_topology();
+    if (opts.autoThreads) {
+        if (opts.numThreads == 0) opts.numThreads = std::max<int>(cpus.size(), 1); // The most the pipeline may grow to
+    } else if (opts.numThreads == 0) {
+        opts.numThreads = std::max<int>(physical_cores(cpus), 1);
+    }
+    if (opts.pin && !cpus.empty()) {
+        sched_getaffinity(0, sizeof(unpinnedMask), &unpinnedMask);
+        pinOrder = placement_order(cpus);
+    }
+
+    if (opts.cache && opts.top != 0) {
+        std::cerr << "Warning: the cache does not keep arguments; --top parses the trace without it\n";
+        opts.cache = false;
+    }
+    scan_lines = select_scanner(opts.simd);
+    trackPids = opts.perPid;
+    trackLatency = opts.latency;
+    trackErrnos = opts.errors;
+    captureRows = opts.cache; // The cache keeps every column, whatever this run reports
+    timelineBucketNs = opts.timeline;
+    topK = opts.top;
+    (opts.cache ? rowFilter : lineFilter) = make_filter(opts);
+
+    if (opts.follow) {
+        if (opts.traceFiles.size() > 1) {
+            std::cerr << "Error: --follow takes a single trace file\n";
+            return 1;
+        }
+        if (is_compressed(opts.traceFile)) {
+            std::cerr << "Error: --follow needs an uncompressed trace file\n";
+            return 1;
+        }
+        return run_follow(opts) ? 0 : 1;
+    }
+
+    bool compressed = std::any_of(opts.traceFiles.begin(), opts.traceFiles.end(), is_compressed);
+    if (compressed || opts.cache) { // run_decode and run_cached have one fixed-size decode and parse pool
+        std::string unused;
+        if (opts.useMmap) unused += " --mmap";
+        if (opts.useRing) unused += " --queue=ring";
+        if (opts.autoThreads) unused += " -j auto";
+        if (!unused.empty()) {
+            std::cerr << "Warning: ignoring" << unused << ": " << (opts.cache ? "with --cache, inputs" : "compressed inputs")
+                      << " go through the decode stage and a fixed pool of " << opts.numThreads << " parser(s)\n";
+        }
+    }
+    if (opts.traceFiles.size() > 1 || opts.perFile) {
+        opts.useMmap = true; // Several inputs are scheduled as chunks over one worker pool
+    }
+
+    std::vector<SyscallStats> statsArray(opts.numThreads); // Create a stats table for each thread
+    std::vector<SyscallStats> perFile;
+    std::unique_ptr<SharedStats> shared; // --aggregate=shared: the tables count calls into this instead
+    if (opts.sharedStats) {
+        shared = std::make_unique<SharedStats>(statsArray.size());
+        shared->attach(statsArray);
+    }
+    ReportWriter report(opts.format);
+    std::unique_ptr<SnapshotReporter> snapshots;
+    if (opts.snapshotInterval != 0) {
+        snapshots = std::make_unique<SnapshotReporter>(*shared, report, opts.snapshotInterval);
+    }
+
+    auto runStart = std::chrono::steady_clock::now();
+    bool ok = opts.cache   ? run_cached(opts, statsArray, perFile)
+            : compressed   ? run_decode(opts, statsArray, perFile)
+            : opts.useMmap ? run_mmap(opts, statsArray, perFile)
+                           : run_queue(opts, statsArray);
+    if (snapshots) snapshots->stop();
+    if (!ok) return 1;
+    auto mergeStart = std::chrono::steady_clock::now();
+
+    // Aggregate per-thread stats into a single table
+    SyscallStats finalStats = merge_all(statsArray);
+    auto printStart = std::chrono::steady_clock::now();
+
+    // Print result
+    if (!write_report(report, finalStats, opts, perFile, ReportWriter::Label{}, nullptr)) return 1;
+    if (opts.profile) {
+        std::cout.flush();
+        for (const auto &path : opts.traceFiles) {
+            std::error_code ec;
+            std::uintmax_t size = std::filesystem::file_size(path, ec);
+            if (!ec) pipelineProfile.inputBytes += size; // An input that went away leaves the total as it was
+        }
+        pipelineProfile.runTime = mergeStart - runStart;
+        pipelineProfile.mergeTime = printStart - mergeStart;
+        pipelineProfile.printTime = std::chrono::steady_clock::now() - printStart;
+        print_profile(std::cerr, statsArray, opts.profileJson);
+    }
     return 0;
     /*==================================End of my Code(2)================================*/
 }
@@ -0,0 +1,289 @@
+/*
+ * strace-bench.cpp — benchmark harness for strace-analyser
+ *
+ * Runs strace-analyser-sequential once and strace-analyser at every requested
+ * thread count and input mode on each trace file, and prints one CSV row per
+ * run with throughput, wall time, CPU time and peak RSS. Each run's output is
+ * compared with the sequential version's, so a parallel mode that is fast but
+ * wrong shows up as match=no. The sequential version does not strip strace -f
+ * pid prefixes, so for a trace that has them (e.g. trace-gen --pids N) the
+ * reference is a 1-thread strace-analyser run instead, and the sequential
+ * rows show match=-.
+ *
+ * Usage:
+ *     ./strace-bench [options] <trace_file>...
+ *
+ * Options:
+ *     --threads LIST     comma separated thread counts (default 1,2,4,8)
+ *     --modes LIST       analyser modes to run: queue, ring, mmap (default queue,mmap)
+ *     --repeat N         runs per configuration (default 3)
+ *     --analyser PATH    analyser binary (default ./strace-analyser)
+ *     --sequential PATH  sequential binary (default ./strace-analyser-sequential)
+ *     --no-sequential    skip the sequential baseline
+ *
+ * Generate inputs with trace-gen, e.g.:
+ *     ./trace-gen --size 1G -o /tmp/trace-1g.txt
+ *     ./strace-bench --threads 1,2,4,8,16 /tmp/trace-1g.txt > results.csv
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct BenchOptions {
+    std::vector<int> threads = {1, 2, 4, 8};
+    std::vector<std::string> modes = {"queue", "mmap"};
+    int repeat = 3;
+    std::string analyser = "./strace-analyser";
+    std::string sequential = "./strace-analyser-sequential";
+    bool runSequential = true;
+    std::vector<std::string> files;
+};
+
+/* Measurements for one run of one binary. */
+struct RunResult {
+    bool ok = false; // exited with status 0
+    double wallSeconds = 0;
+    double userSeconds = 0;
+    double sysSeconds = 0;
+    long maxRssKb = 0;
+    std::string output;
+};
+
+std::vector<std::string> split_list(const std::string &text) {
+    std::vector<std::string> items;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+void print_usage(const char *prog) {
+    std::cerr << "Usage: " << prog
+              << " [--threads LIST] [--modes queue,ring,mmap] [--repeat N]"
+              << " [--analyser PATH] [--sequential PATH] [--no-sequential]"
+              << " <trace_file>...\n";
+}
+
+bool parse_options(int argc, char *argv[], BenchOptions &opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        try {
+            if (arg == "--threads" && hasValue) {
+                opts.threads.clear();
+                for (const auto &t : split_list(argv[++i])) {
+                    int n = std::stoi(t);
+                    if (n <= 0) return false;
+                    opts.threads.push_back(n);
+                }
+            } else if (arg == "--modes" && hasValue) {
+                opts.modes = split_list(argv[++i]);
+                for (const auto &m : opts.modes) {
+                    if (m != "queue" && m != "ring" && m != "mmap") return false;
+                }
+            } else if (arg == "--repeat" && hasValue) {
+                opts.repeat = std::stoi(argv[++i]);
+                if (opts.repeat <= 0) return false;
+            } else if (arg == "--analyser" && hasValue) {
+                opts.analyser = argv[++i];
+            } else if (arg == "--sequential" && hasValue) {
+                opts.sequential = argv[++i];
+            } else if (arg == "--no-sequential") {
+                opts.runSequential = false;
+            } else if (arg.compare(0, 2, "--") == 0) {
+                return false;
+            } else {
+                opts.files.push_back(arg);
+            }
+        } catch (...) {
+            return false;
+        }
+    }
+    return !opts.files.empty();
+}
+
+/* count_input returns the size of a file and the number of lines in it. */
+bool count_input(const std::string &path, std::uint64_t &bytes, std::uint64_t &lines) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bytes = lines = 0;
+    std::vector<char> buf(1 << 20);
+    ssize_t n;
+    char last = '\n';
+    while ((n = read(fd, buf.data(), buf.size())) > 0) {
+        bytes += n;
+        for (const char *p = buf.data(), *end = buf.data() + n;
+             (p = static_cast<const char *>(std::memchr(p, '\n', end - p))) != nullptr; p++) {
+            lines++;
+        }
+        last = buf[n - 1];
+    }
+    if (last != '\n') lines++; // Unterminated last line
+    close(fd);
+    return n == 0;
+}
+
+/*
+ * has_pid_prefixes tells whether the first lines of a trace start with a
+ * strace -f pid, "[pid 1234] " or "1234 ". A -t/-tt/-ttt timestamp is
+ * followed by ':' or '.', not a space, so it does not count.
+ */
+bool has_pid_prefixes(const std::string &path) {
+    std::ifstream in(path);
+    std::string line;
+    for (int n = 0; n < 1000 && std::getline(in, line); n++) {
+        if (line.compare(0, 5, "[pid ") == 0) return true;
+        std::size_t digits = line.find_first_not_of("0123456789");
+        if (digits != 0 && digits != std::string::npos && line[digits] == ' ') return true;
+    }
+    return false;
+}
+
+/*
+ * run_once runs 'args' (args[0] is the binary) with stdout captured to a
+ * temporary file and stderr discarded, and reports wall time and the child's
+ * resource usage from wait4().
+ */
+RunResult run_once(const std::vector<std::string> &args) {
+    RunResult r;
+    char outPath[] = "/tmp/strace-bench-XXXXXX";
+    int outFd = mkstemp(outPath);
+    if (outFd < 0) return r;
+    unlink(outPath);
+
+    std::vector<char *> argv;
+    for (const auto &a : args) argv.push_back(const_cast<char *>(a.c_str()));
+    argv.push_back(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(outFd, STDOUT_FILENO);
+        if (devNull >= 0) dup2(devNull, STDERR_FILENO);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    if (pid < 0) {
+        close(outFd);
+        return r;
+    }
+
+    int status = 0;
+    struct rusage ru;
+    wait4(pid, &status, 0, &ru);
+    r.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    r.userSeconds = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+    r.sysSeconds = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+    r.maxRssKb = ru.ru_maxrss;
+    r.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    lseek(outFd, 0, SEEK_SET);
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(outFd, buf, sizeof(buf))) > 0) {
+        r.output.append(buf, n);
+    }
+    close(outFd);
+    return r;
+}
+
+/* csv_field quotes 'text' if it holds a comma, quote or line break. */
+std::string csv_field(const std::string &text) {
+    if (text.find_first_of(",\"\n\r") == std::string::npos) return text;
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+void print_row(const std::string &program, const std::string &mode, int threads,
+               const std::string &file, std::uint64_t bytes, std::uint64_t lines,
+               int run, const RunResult &r, const std::string &match) {
+    double mb = bytes / (1024.0 * 1024.0);
+    double wall = r.wallSeconds > 0 ? r.wallSeconds : 1e-9;
+    std::printf("%s,%s,%d,%s,%llu,%llu,%d,%.4f,%.4f,%.4f,%.4f,%ld,%.2f,%.0f,%s,%s\n",
+                program.c_str(), mode.c_str(), threads, csv_field(file).c_str(),
+                static_cast<unsigned long long>(bytes), static_cast<unsigned long long>(lines), run,
+                r.wallSeconds, r.userSeconds, r.sysSeconds, r.userSeconds + r.sysSeconds,
+                r.maxRssKb, mb / wall, lines / wall, r.ok ? "yes" : "no", match.c_str());
+    std::fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions opts;
+    if (!parse_options(argc, argv, opts)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::printf("program,mode,threads,file,bytes,lines,run,wall_s,user_s,sys_s,cpu_s,"
+                "max_rss_kb,mb_per_s,lines_per_s,exit_ok,match\n");
+
+    for (const auto &file : opts.files) {
+        std::uint64_t bytes = 0, lines = 0;
+        if (!count_input(file, bytes, lines)) {
+            std::cerr << "Error: cannot read trace file: " << file << "\n";
+            return 1;
+        }
+
+        std::string reference; // Output every run is checked against
+        bool haveReference = false;
+        bool pidPrefixes = has_pid_prefixes(file);
+        if (pidPrefixes) {
+            RunResult r = run_once({opts.analyser, file, "1"});
+            if (r.ok) {
+                reference = r.output;
+                haveReference = true;
+            }
+        }
+
+        if (opts.runSequential) {
+            for (int run = 1; run <= opts.repeat; run++) {
+                RunResult r = run_once({opts.sequential, file});
+                if (!haveReference && r.ok) {
+                    reference = r.output;
+                    haveReference = true;
+                }
+                print_row("sequential", "-", 1, file, bytes, lines, run, r,
+                          haveReference && !pidPrefixes ? (r.output == reference ? "yes" : "no") : "-");
+            }
+        }
+
+        for (const auto &mode : opts.modes) {
+            for (int threads : opts.threads) {
+                for (int run = 1; run <= opts.repeat; run++) {
+                    std::vector<std::string> args = {opts.analyser};
+                    if (mode == "mmap") args.push_back("--mmap");
+                    if (mode == "ring") args.push_back("--queue=ring");
+                    args.push_back(file);
+                    args.push_back(std::to_string(threads));
+
+                    RunResult r = run_once(args);
+                    if (!haveReference && r.ok) {
+                        reference = r.output;
+                        haveReference = true;
+                    }
+                    print_row("strace-analyser", mode, threads, file, bytes, lines, run, r,
+                              r.output == reference ? "yes" : "no");
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,379 @@
+/*
+ * trace-gen.cpp — synthetic strace log generator for benchmarking
+ *
+ * Writes a trace in the format strace-analyser reads, e.g.:
+ *
+ *     openat(AT_FDCWD, "/usr/lib/libc.so.6", O_RDONLY|O_CLOEXEC) = 3
+ *
+ * The output depends only on the options (including --seed), so the same
+ * command always produces the same bytes and benchmark runs are comparable.
+ * All randomness comes from a local SplitMix64 generator rather than
+ * <random>, whose distributions differ between standard libraries.
+ *
+ * Usage:
+ *     ./trace-gen [options] [-o out_file]
+ *
+ * Options:
+ *     --size SIZE[K|M|G]   stop after about this many bytes (default 100M)
+ *     --seed N             generator seed (default 1)
+ *     --mix NAME:W,...     syscall mix as relative weights
+ *                          (default: a mix resembling a build/file scan)
+ *     --fail-rate F        fraction of calls that fail with -1 ERRNO (default 0.02)
+ *     --line-length L      short | mixed | long argument lengths (default mixed)
+ *     --pids N             number of interleaved processes (default 1)
+ *     --pid-format F       none | bare | bracket: how the pid prefix is written
+ *                          when --pids > 1 (default bracket, as "[pid 1234] ")
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* SplitMix64: small, fast and identical on every platform. */
+class Rng {
+public:
+    explicit Rng(std::uint64_t seed) : state_(seed) {}
+
+    std::uint64_t next() {
+        std::uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    /* Uniform integer in [lo, hi]. */
+    std::uint64_t range(std::uint64_t lo, std::uint64_t hi) {
+        return lo + next() % (hi - lo + 1);
+    }
+
+    /* Uniform double in [0, 1). */
+    double unit() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    std::uint64_t state_;
+};
+
+struct MixEntry {
+    std::string name;
+    double weight;
+};
+
+struct GenOptions {
+    std::uint64_t size = 100ULL << 20;
+    std::uint64_t seed = 1;
+    std::vector<MixEntry> mix = {
+        {"openat", 14}, {"read", 12}, {"close", 14}, {"fstat", 6},
+        {"newfstatat", 10}, {"getdents64", 8}, {"mmap", 5}, {"mprotect", 2},
+        {"fcntl", 10}, {"write", 6}, {"futex", 4}, {"lseek", 2},
+        {"stat", 2}, {"access", 1}, {"brk", 1}, {"wait4", 3},
+    };
+    double failRate = 0.02;
+    std::string lineLength = "mixed";
+    int pids = 1;
+    std::string pidFormat = "bracket";
+    std::string outFile;
+};
+
+bool parse_size(const std::string &text, std::uint64_t &out) {
+    try {
+        std::size_t used = 0;
+        long long n = std::stoll(text, &used);
+        if (n < 0) return false;
+        std::string suffix = text.substr(used);
+        int shift = 0;
+        if (suffix == "K" || suffix == "k") shift = 10;
+        else if (suffix == "M" || suffix == "m") shift = 20;
+        else if (suffix == "G" || suffix == "g") shift = 30;
+        else if (!suffix.empty()) return false;
+        out = static_cast<std::uint64_t>(n) << shift;
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+/* parse_mix reads "name:weight,name:weight,..."; the weights must not all be 0. */
+bool parse_mix(const std::string &text, std::vector<MixEntry> &out) {
+    out.clear();
+    double total = 0;
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        std::size_t comma = text.find(',', pos);
+        if (comma == std::string::npos) comma = text.size();
+        std::string item = text.substr(pos, comma - pos);
+        std::size_t colon = item.find(':');
+        try {
+            double w = (colon == std::string::npos) ? 1.0 : std::stod(item.substr(colon + 1));
+            if (!std::isfinite(w) || w < 0) return false;
+            out.push_back({item.substr(0, colon), w});
+            total += w;
+        } catch (...) {
+            return false;
+        }
+        pos = comma + 1;
+    }
+    return total > 0; // With no weight the cumulative table is all NaN
+}
+
+void print_usage(const char *prog) {
+    std::cerr << "Usage: " << prog
+              << " [--size SIZE[K|M|G]] [--seed N] [--mix NAME:W,...] [--fail-rate F]"
+              << " [--line-length short|mixed|long] [--pids N] [--pid-format none|bare|bracket]"
+              << " [-o out_file]\n";
+}
+
+bool parse_options(int argc, char *argv[], GenOptions &opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        try {
+            if (arg == "--size" && hasValue) {
+                if (!parse_size(argv[++i], opts.size)) return false;
+            } else if (arg == "--seed" && hasValue) {
+                opts.seed = std::stoull(argv[++i]);
+            } else if (arg == "--mix" && hasValue) {
+                if (!parse_mix(argv[++i], opts.mix)) return false;
+            } else if (arg == "--fail-rate" && hasValue) {
+                opts.failRate = std::stod(argv[++i]);
+            } else if (arg == "--line-length" && hasValue) {
+                opts.lineLength = argv[++i];
+                if (opts.lineLength != "short" && opts.lineLength != "mixed" && opts.lineLength != "long") return false;
+            } else if (arg == "--pids" && hasValue) {
+                opts.pids = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--pid-format" && hasValue) {
+                opts.pidFormat = argv[++i];
+                if (opts.pidFormat != "none" && opts.pidFormat != "bare" && opts.pidFormat != "bracket") return false;
+            } else if (arg == "-o" && hasValue) {
+                opts.outFile = argv[++i];
+            } else {
+                return false;
+            }
+        } catch (...) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * TraceWriter builds lines into a large buffer and writes it out in big
+ * blocks, so generating tens of gigabytes is not dominated by stdio calls.
+ */
+class TraceWriter {
+public:
+    explicit TraceWriter(std::FILE *out) : out_(out) {
+        buf_.reserve(kFlushAt + 8192);
+    }
+
+    ~TraceWriter() { flush(); }
+
+    /* True once a write came up short, e.g. on a full disk. */
+    bool failed() const { return failed_; }
+
+    void append(const char *s, std::size_t n) { buf_.append(s, n); }
+    void append(const std::string &s) { buf_.append(s); }
+    void append(const char *s) { buf_.append(s); }
+
+    void append_number(std::int64_t v) {
+        char tmp[24];
+        int n = std::snprintf(tmp, sizeof(tmp), "%lld", static_cast<long long>(v));
+        buf_.append(tmp, n);
+    }
+
+    void append_hex(std::uint64_t v) {
+        char tmp[24];
+        int n = std::snprintf(tmp, sizeof(tmp), "0x%llx", static_cast<unsigned long long>(v));
+        buf_.append(tmp, n);
+    }
+
+    /* Ends the current line; returns the total number of bytes produced so far. */
+    std::uint64_t end_line() {
+        buf_.push_back('\n');
+        if (buf_.size() >= kFlushAt) flush();
+        return written_ + buf_.size();
+    }
+
+    void flush() {
+        if (buf_.empty()) return;
+        if (std::fwrite(buf_.data(), 1, buf_.size(), out_) != buf_.size()) failed_ = true;
+        written_ += buf_.size();
+        buf_.clear();
+    }
+
+private:
+    static constexpr std::size_t kFlushAt = 1 << 20;
+    std::FILE *out_;
+    std::string buf_;
+    std::uint64_t written_ = 0;
+    bool failed_ = false;
+};
+
+struct Errno {
+    const char *name;
+    const char *text;
+};
+
+const Errno kErrnos[] = {
+    {"ENOENT", "No such file or directory"},
+    {"EACCES", "Permission denied"},
+    {"EAGAIN", "Resource temporarily unavailable"},
+    {"EINVAL", "Invalid argument"},
+    {"EBADF", "Bad file descriptor"},
+    {"ENOTDIR", "Not a directory"},
+};
+
+class TraceGenerator {
+public:
+    TraceGenerator(const GenOptions &opts, TraceWriter &out) : opts_(opts), out_(out), rng_(opts.seed) {
+        double total = 0;
+        for (const auto &m : opts_.mix) total += m.weight;
+        double acc = 0;
+        for (const auto &m : opts_.mix) {
+            acc += m.weight / total;
+            cumulative_.push_back(acc);
+        }
+        for (int i = 0; i < opts_.pids; i++) {
+            pidList_.push_back(1000 + static_cast<int>(rng_.range(0, 60000)));
+        }
+    }
+
+    void run() {
+        std::uint64_t produced = 0;
+        while (produced < opts_.size && !out_.failed()) {
+            produced = write_line();
+        }
+    }
+
+private:
+    const std::string &pick_syscall() {
+        double u = rng_.unit();
+        std::size_t i = std::lower_bound(cumulative_.begin(), cumulative_.end(), u) - cumulative_.begin();
+        return opts_.mix[std::min(i, opts_.mix.size() - 1)].name;
+    }
+
+    /* Length of the variable part of a line (path or buffer), per --line-length. */
+    std::size_t arg_length() {
+        if (opts_.lineLength == "short") return rng_.range(4, 32);
+        if (opts_.lineLength == "long") return rng_.range(128, 2048);
+        return rng_.unit() < 0.95 ? rng_.range(8, 64) : rng_.range(256, 4096); // mixed: mostly short, some very long
+    }
+
+    void append_path() {
+        static const char kChars[] = "abcdefghijklmnopqrstuvwxyz0123456789_-./";
+        std::size_t n = arg_length();
+        out_.append("\"/");
+        for (std::size_t i = 0; i < n; i++) {
+            char c = kChars[rng_.next() % (sizeof(kChars) - 1)];
+            out_.append(&c, 1);
+        }
+        out_.append("\"");
+    }
+
+    void append_pid_prefix() {
+        if (opts_.pids <= 1 || opts_.pidFormat == "none") return;
+        int pid = pidList_[rng_.next() % pidList_.size()];
+        if (opts_.pidFormat == "bracket") {
+            out_.append("[pid ");
+            out_.append_number(pid);
+            out_.append("] ");
+        } else {
+            out_.append_number(pid);
+            out_.append("  ");
+        }
+    }
+
+    std::uint64_t write_line() {
+        const std::string &name = pick_syscall();
+        bool fail = rng_.unit() < opts_.failRate;
+
+        append_pid_prefix();
+        out_.append(name);
+        out_.append("(");
+        std::int64_t result = 0;
+        bool hexResult = false;
+        if (name == "openat") {
+            out_.append("AT_FDCWD, ");
+            append_path();
+            out_.append(", O_RDONLY|O_CLOEXEC");
+            result = static_cast<std::int64_t>(rng_.range(3, 255));
+        } else if (name == "stat" || name == "access" || name == "newfstatat" || name == "execve") {
+            append_path();
+            out_.append(", 0x7ffd5e3c");
+        } else if (name == "read" || name == "write" || name == "getdents64") {
+            out_.append_number(static_cast<std::int64_t>(rng_.range(3, 64)));
+            out_.append(", ");
+            append_path(); // Stands in for the data buffer strace prints
+            out_.append("..., 4096");
+            result = static_cast<std::int64_t>(rng_.range(0, 4096));
+        } else if (name == "mmap" || name == "brk") {
+            out_.append("NULL, 8192, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0");
+            hexResult = true;
+        } else {
+            out_.append_number(static_cast<std::int64_t>(rng_.range(0, 64)));
+            out_.append(", 0x");
+            out_.append_number(static_cast<std::int64_t>(rng_.range(0, 1 << 20)));
+        }
+        out_.append(") = ");
+
+        if (fail) {
+            const Errno &e = kErrnos[rng_.next() % (sizeof(kErrnos) / sizeof(kErrnos[0]))];
+            out_.append("-1 ");
+            out_.append(e.name);
+            out_.append(" (");
+            out_.append(e.text);
+            out_.append(")");
+        } else if (hexResult) {
+            out_.append_hex(0x7f0000000000ULL + (rng_.next() & 0xffffffffffULL));
+        } else {
+            out_.append_number(result);
+        }
+        return out_.end_line();
+    }
+
+    const GenOptions &opts_;
+    TraceWriter &out_;
+    Rng rng_;
+    std::vector<double> cumulative_;
+    std::vector<int> pidList_;
+};
+
+int main(int argc, char *argv[]) {
+    GenOptions opts;
+    if (!parse_options(argc, argv, opts)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::FILE *out = stdout;
+    if (!opts.outFile.empty()) {
+        out = std::fopen(opts.outFile.c_str(), "wb");
+        if (out == nullptr) {
+            std::cerr << "Error: cannot open output file: " << opts.outFile << "\n";
+            return 1;
+        }
+    }
+
+    bool failed = false;
+    {
+        TraceWriter writer(out);
+        TraceGenerator gen(opts, writer);
+        gen.run();
+        writer.flush();
+        failed = writer.failed();
+    }
+
+    if (std::fflush(out) != 0) failed = true;
+    if (out != stdout && std::fclose(out) != 0) failed = true;
+    if (failed) {
+        std::cerr << "Error: failed writing " << (opts.outFile.empty() ? "standard output" : opts.outFile) << "\n";
+        return 1;
+    }
+    return 0;
+}